@@ -0,0 +1,345 @@
+/* Samples streamed between hosts, see agent.h.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Every socket is non-blocking. The agent sends each record with a single
+ * send(): a client whose buffer is full misses it whole, and one that only
+ * takes part of it is dropped, as it could not tell records apart anymore.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/un.h>
+
+#include "agent.h"
+#include "render.h"
+
+static void
+put16(uint8_t* p, unsigned v)
+{
+    p[0] = v>>8; p[1] = v;
+}
+
+static void
+put32(uint8_t* p, uint32_t v)
+{
+    p[0] = v>>24; p[1] = v>>16; p[2] = v>>8; p[3] = v;
+}
+
+static unsigned get16(const uint8_t* p) { return p[0]<<8 | p[1]; }
+static uint32_t get32(const uint8_t* p) { return (uint32_t)p[0]<<24 | p[1]<<16 | p[2]<<8 | p[3]; }
+
+static int
+percent(int value, int scale)
+{
+    int p = value*100/scale;
+    return p < 0 ? 0 : p > 100 ? 100 : p;
+}
+
+void
+agent_encode(uint8_t* r, const Sample* s, int scale, uint32_t seq)
+{
+    put32(r, seq);
+    r[4] = percent(s->cpu.usage, scale);
+    r[5] = percent(s->cgroup ? s->throttled : s->cpu.iowait, scale);
+    r[6] = percent(s->freq_avg, scale);
+    r[7] = s->temp < 0 ? 0 : s->temp > 255 ? 255 : s->temp;
+    put16(r+8, s->freq.avg/1000);
+    unsigned dw = s->power.package/100;
+    put16(r+10, dw > 0xffff ? 0xffff : dw);
+    r[12] = percent(s->power.share, scale);
+    r[13] = percent(s->psi[PSI_CPU].some, scale);
+    r[14] = s->n_cores > 255 ? 255 : s->n_cores;
+    r[15] = s->cgroup ? AGENT_CGROUP : 0;
+}
+
+void
+agent_decode(AgentSample* s, const uint8_t* r)
+{
+    s->seq = get32(r);
+    s->usage = r[4];
+    s->iowait = r[5];
+    s->freq = r[6];
+    s->temp = r[7];
+    s->freq_mhz = get16(r+8);
+    s->power_mw = get16(r+10)*100;
+    s->power_share = r[12];
+    s->psi_cpu = r[13];
+    s->n_cores = r[14];
+    s->flags = r[15];
+}
+
+static int
+set_nonblocking(int fd)
+{
+    return fcntl(fd, F_SETFD, FD_CLOEXEC) < 0
+        || fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 ? -1 : 0;
+}
+
+/* "/path" or "unix:/path", else "host:port", "[v6]:port" or ":port" */
+static int
+resolve(const char* address, struct sockaddr_storage* addr, socklen_t* len, int passive)
+{
+    memset(addr, 0, sizeof(*addr));
+    if( !strncmp(address, "unix:", 5) )
+        address += 5;
+    else if( *address != '/' ) {
+        const char* colon = strrchr(address, ':');
+        char host[256];
+        if( !colon || colon-address >= sizeof(host) ) {
+            errno = EINVAL;
+            return -1;
+        }
+        memcpy(host, address, colon-address);
+        host[colon-address] = 0;
+        if( *host == '[' && colon > address+1 && colon[-1] == ']' ) {
+            memmove(host, host+1, colon-address-2);
+            host[colon-address-2] = 0;
+        }
+        struct addrinfo hints = { .ai_socktype = SOCK_STREAM,
+                                  .ai_flags = passive ? AI_PASSIVE : 0 }, *ai;
+        if( getaddrinfo(*host ? host : NULL, colon+1, &hints, &ai) ) {
+            errno = EHOSTUNREACH;
+            return -1;
+        }
+        memcpy(addr, ai->ai_addr, ai->ai_addrlen);
+        *len = ai->ai_addrlen;
+        freeaddrinfo(ai);
+        return 0;
+    }
+    struct sockaddr_un* un = (struct sockaddr_un*)addr;
+    if( strlen(address) >= sizeof(un->sun_path) ) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    un->sun_family = AF_UNIX;
+    strcpy(un->sun_path, address);
+    *len = sizeof(*un);
+    return 0;
+}
+
+/* Agent side */
+
+struct AgentServer {
+    int fd;
+    int clients[AGENT_MAX_CLIENTS], n_clients;
+    uint32_t seq;
+    char path[108];  /* of the Unix socket, removed on agent_stop() */
+    uint8_t hello[AGENT_HELLO_SIZE];
+};
+
+AgentServer*
+agent_serve(const char* address)
+{
+    struct sockaddr_storage addr;
+    socklen_t len;
+    if( resolve(address, &addr, &len, 1) < 0 )
+        return NULL;
+    AgentServer* server = calloc(1, sizeof(*server));
+    if( !server )
+        return NULL;
+    if( addr.ss_family == AF_UNIX ) {
+        /* A socket left behind by an agent that died */
+        strcpy(server->path, ((struct sockaddr_un*)&addr)->sun_path);
+        unlink(server->path);
+    }
+    int on = 1;
+    if( (server->fd = socket(addr.ss_family, SOCK_STREAM, 0)) < 0
+     || set_nonblocking(server->fd) < 0
+     || (addr.ss_family != AF_UNIX
+         && setsockopt(server->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0)
+     || bind(server->fd, (struct sockaddr*)&addr, len) < 0
+     || listen(server->fd, AGENT_MAX_CLIENTS) < 0 ) {
+        int e = errno;
+        if( server->fd >= 0 )
+            close(server->fd);
+        free(server);
+        errno = e;
+        return NULL;
+    }
+    memcpy(server->hello, "gatoagnt", 8);
+    put16(server->hello+8, AGENT_VERSION);
+    put16(server->hello+10, AGENT_RECORD_SIZE);
+    gethostname((char*)server->hello+16, AGENT_HELLO_SIZE-16-1);
+    return server;
+}
+
+static int
+send_all(int fd, const uint8_t* buf, size_t len)
+{
+    ssize_t n = send(fd, buf, len, MSG_DONTWAIT|MSG_NOSIGNAL);
+    return n == len ? 1 : n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+int
+agent_publish(AgentServer* server, const Sample* sample, int scale)
+{
+    int fd;
+    while( server->n_clients < AGENT_MAX_CLIENTS
+        && (fd = accept(server->fd, NULL, NULL)) >= 0 ) {
+        if( set_nonblocking(fd) < 0 || send_all(fd, server->hello, AGENT_HELLO_SIZE) < 1 )
+            close(fd);
+        else
+            server->clients[server->n_clients++] = fd;
+    }
+    uint8_t record[AGENT_RECORD_SIZE];
+    agent_encode(record, sample, scale, server->seq++);
+    int sent = 0;
+    for(int i=0; i<server->n_clients; ) {
+        int r = send_all(server->clients[i], record, sizeof(record));
+        if( r < 0 ) {
+            close(server->clients[i]);
+            server->clients[i] = server->clients[--server->n_clients];
+            continue;
+        }
+        sent += r;
+        i++;
+    }
+    return sent;
+}
+
+void
+agent_stop(AgentServer* server)
+{
+    if( !server )
+        return;
+    for(int i=0; i<server->n_clients; i++)
+        close(server->clients[i]);
+    close(server->fd);
+    if( *server->path )
+        unlink(server->path);
+    free(server);
+}
+
+/* Tray side */
+
+int
+agent_peer_init(AgentPeer* p, const char* address)
+{
+    memset(p, 0, sizeof(*p));
+    p->address = address;
+    p->fd = -1;
+    return resolve(address, &p->addr, &p->addr_len, 0);
+}
+
+int
+agent_connect(AgentPeer* p)
+{
+    agent_disconnect(p);
+    if( (p->fd = socket(p->addr.ss_family, SOCK_STREAM, 0)) < 0 )
+        return -1;
+    if( set_nonblocking(p->fd) < 0
+     || (connect(p->fd, (struct sockaddr*)&p->addr, p->addr_len) < 0 && errno != EINPROGRESS) ) {
+        agent_disconnect(p);
+        return -1;
+    }
+    p->state = AGENT_CONNECTING;
+    return p->fd;
+}
+
+void
+agent_disconnect(AgentPeer* p)
+{
+    if( p->fd >= 0 )
+        close(p->fd);
+    p->fd = -1;
+    p->state = AGENT_DOWN;
+    p->have = 0;
+}
+
+int
+agent_receive(AgentPeer* p)
+{
+    int records = 0;
+    for(;;) {
+        ssize_t n = read(p->fd, p->buf+p->have, sizeof(p->buf)-p->have);
+        if( n < 0 && errno == EINTR )
+            continue;
+        if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+            break;
+        if( n <= 0 ) {
+            agent_disconnect(p);
+            return -1;
+        }
+        p->have += n;
+        const uint8_t* b = p->buf;
+        if( p->state == AGENT_CONNECTING ) {
+            if( p->have < AGENT_HELLO_SIZE )
+                continue;
+            if( memcmp(b, "gatoagnt", 8) || get16(b+8) != AGENT_VERSION
+             || get16(b+10) != AGENT_RECORD_SIZE ) {
+                agent_disconnect(p);
+                return -1;
+            }
+            memcpy(p->host, b+16, sizeof(p->host)-1);
+            p->host[sizeof(p->host)-1] = 0;
+            p->state = AGENT_STREAMING;
+            b += AGENT_HELLO_SIZE;
+        }
+        /* Only the latest record matters, the ones before it are history */
+        for(; b+AGENT_RECORD_SIZE <= p->buf+p->have; b += AGENT_RECORD_SIZE, records++)
+            agent_decode(&p->last, b);
+        p->have -= b-p->buf;
+        memmove(p->buf, b, p->have);
+    }
+    if( records )
+        p->seen = time(NULL);
+    return records;
+}
+
+static int
+agent_fresh(const AgentPeer* p, long long now)
+{
+    return p->state == AGENT_STREAMING && p->seen && now - p->seen <= AGENT_STALE;
+}
+
+static void
+worsen(int* value, int v)
+{
+    if( v > *value )
+        *value = v;
+}
+
+void
+agent_worst(int* values, const AgentPeer* peers, int n, long long now, int scale)
+{
+    for(const AgentPeer* p = peers; p < peers+n; p++) {
+        if( !agent_fresh(p, now) )
+            continue;
+        const AgentSample* s = &p->last;
+        worsen(&values[H_USAGE], s->usage*scale/100);
+        worsen(&values[H_IOWAIT], s->iowait*scale/100);
+        worsen(&values[H_FREQ], s->freq*scale/100);
+        worsen(&values[H_FREQ_MAX], s->freq*scale/100);
+        worsen(&values[H_TEMP], s->temp);
+        worsen(&values[H_POWER], s->power_share*scale/100);
+        worsen(&values[H_PSI_SOME(PSI_CPU)], s->psi_cpu*scale/100);
+    }
+}
+
+int
+agent_tooltip(char* buf, size_t size, const AgentPeer* peers, int n, long long now)
+{
+    int len = 0;
+    for(const AgentPeer* p = peers; p < peers+n && len < size; p++) {
+        const char* name = *p->host ? p->host : p->address;
+        const AgentSample* s = &p->last;
+        if( !agent_fresh(p, now) )
+            len += snprintf(buf+len, size-len, "%s: %s\n", name,
+                            p->state == AGENT_DOWN ? "down" : "no data");
+        else
+            len += snprintf(buf+len, size-len, "%s: %d%% @ %d MHz, %d%%%s, %d C, %d.%d W\n",
+                            name, s->usage, s->freq_mhz, s->iowait,
+                            s->flags & AGENT_CGROUP ? "thr" : "wa", s->temp,
+                            s->power_mw/1000, s->power_mw%1000/100);
+    }
+    return len;
+}
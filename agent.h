@@ -0,0 +1,87 @@
+/* Samples streamed between hosts: a headless agent and the tray watching it.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * An agent listens on a Unix socket ("/path" or "unix:/path") or on TCP
+ * ("host:port", or ":port" for every address). Each client that connects
+ * gets a AGENT_HELLO_SIZE hello naming the host, then one AGENT_RECORD_SIZE
+ * record per sample, in network byte order:
+ *
+ *   hello:  "gatoagnt" version:u16 record_size:u16 reserved:u32 host:char[32]
+ *   record: seq:u32 usage:u8 iowait:u8 freq:u8 temp:u8 freq_mhz:u16
+ *           power_dw:u16 power_share:u8 psi_cpu:u8 n_cores:u8 flags:u8
+ *
+ * usage, iowait, freq (within the agent's own range), power_share and
+ * psi_cpu are percents, temp is Celsius and power_dw deciwatts. Clients
+ * that can't keep up miss records rather than slowing the agent down.
+ */
+#ifndef AGENT_H
+#define AGENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "cpu_usage.h"
+
+#define AGENT_VERSION 1
+#define AGENT_HELLO_SIZE 48
+#define AGENT_RECORD_SIZE 16
+#define AGENT_MAX_CLIENTS 16
+#define AGENT_STALE 5 /* seconds without records before a peer is left out */
+
+/* 'flags' of a record */
+#define AGENT_CGROUP 1 /* iowait is the throttled share of a cgroup */
+
+typedef struct {
+    uint32_t seq;
+    int usage, iowait, freq, temp; /* as in the record */
+    int freq_mhz, power_mw, power_share, psi_cpu;
+    int n_cores, flags;
+} AgentSample;
+
+void agent_encode(uint8_t* record, const Sample* sample, int scale, uint32_t seq);
+void agent_decode(AgentSample* s, const uint8_t* record);
+
+/* Agent side: accepts clients and sends them every sample, never blocking */
+typedef struct AgentServer AgentServer;
+
+/* Listens at 'address'. Returns NULL, with errno set, on failure. */
+AgentServer* agent_serve(const char* address);
+/* Accepts pending clients and sends them 'sample'. Returns how many got it. */
+int agent_publish(AgentServer* server, const Sample* sample, int scale);
+void agent_stop(AgentServer* server);
+
+/* Tray side: one agent being watched */
+enum { AGENT_DOWN, AGENT_CONNECTING, AGENT_STREAMING };
+
+typedef struct {
+    const char* address;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int fd, state;
+    char host[32];          /* as the agent names itself */
+    uint8_t buf[AGENT_HELLO_SIZE + 64*AGENT_RECORD_SIZE];
+    int have;               /* bytes of an incomplete hello or record */
+    AgentSample last;
+    long long seen;         /* time() of the last record */
+} AgentPeer;
+
+/* Resolves 'address', once, as names may take long. Returns -1 if it can't. */
+int agent_peer_init(AgentPeer* p, const char* address);
+/* Starts connecting without blocking. Returns the socket, or -1. */
+int agent_connect(AgentPeer* p);
+/* Reads whatever arrived. Returns how many records did, -1 once the
+ * connection is lost, after closing it. */
+int agent_receive(AgentPeer* p);
+void agent_disconnect(AgentPeer* p);
+
+/* Raises the H_* series of 'values', as render_sample() fills them, to the
+ * worst of every peer heard from since 'now'-AGENT_STALE. */
+void agent_worst(int* values, const AgentPeer* peers, int n, long long now, int scale);
+/* One tooltip line per peer, as snprintf() does */
+int agent_tooltip(char* buf, size_t size, const AgentPeer* peers, int n, long long now);
+
+#endif
@@ -0,0 +1,597 @@
+/* gatotray-bench: per-tick cost of every stage, over a fixture tree.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Builds a fake /proc and /sys with the given number of cores and
+ * processes under a temporary directory, or uses --root, and times each
+ * stage until it has run for a while. Prints one JSON object per line:
+ *   {"stage":"render","size":22,"iterations":N,"ns_per_op":T,
+ *    "allocs_per_op":A,"bytes_per_op":B}
+ * Then, for a few simulated loads, {"schedule":"idle","wakeups_per_min":W}
+ * against 60 for a fixed 1s tick, followed by {"peak_rss_kb":K}.
+ * Allocations are counted by wrapping glibc's malloc, so they include
+ * those made by libc itself, e.g. fopen().
+ */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <errno.h>
+#include <getopt.h>
+#include <ftw.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "cpu_usage.h"
+#include "history.h"
+#include "render.h"
+#include "schedule.h"
+#include "procs.h"
+#include "tty.h"
+#include "agent.h"
+#include "flight.h"
+
+/* Allocation counters, fed by the wrappers below */
+static unsigned long long allocs = 0, alloc_bytes = 0;
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+extern void __libc_free(void* p);
+
+void* malloc(size_t size) { allocs++; alloc_bytes += size; return __libc_malloc(size); }
+void* calloc(size_t n, size_t size) { allocs++; alloc_bytes += n*size; return __libc_calloc(n, size); }
+void* realloc(void* p, size_t size) { allocs++; alloc_bytes += size; return __libc_realloc(p, size); }
+void free(void* p) { __libc_free(p); }
+
+static long long
+now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000000LL + t.tv_nsec;
+}
+
+static long long min_ns = 200000000; /* run each stage at least this long */
+
+/* Times op(ctx), doubling the iterations until they take min_ns */
+static void
+measure(const char* stage, int size, void (*op)(void*), void* ctx)
+{
+    op(ctx); /* warm up, and let lazy allocations happen */
+    for(long n=1;; n*=2)
+    {
+        unsigned long long a = allocs, b = alloc_bytes;
+        long long start = now_ns();
+        for(long i=0; i<n; i++)
+            op(ctx);
+        long long elapsed = now_ns() - start;
+        if( elapsed < min_ns && n < (1L<<40) )
+            continue;
+        printf("{\"stage\":\"%s\",\"size\":%d,\"iterations\":%ld,\"ns_per_op\":%.1f,"
+               "\"allocs_per_op\":%.3f,\"bytes_per_op\":%.1f}\n",
+               stage, size, n, (double)elapsed/n,
+               (double)(allocs-a)/n, (double)(alloc_bytes-b)/n);
+        fflush(stdout);
+        return;
+    }
+}
+
+/* Fixture tree */
+
+static char fixture[64];
+
+static void __attribute__((format(printf, 2, 3)))
+write_file(const char* path, const char* fmt, ...)
+{
+    char full[512];
+    snprintf(full, sizeof(full), "%s%s", fixture, path);
+    /* Make parent directories on the way */
+    for(char* p = full+strlen(fixture)+1; (p = strchr(p, '/')); p++) {
+        *p = '\0';
+        mkdir(full, 0755);
+        *p = '/';
+    }
+    FILE* f = fopen(full, "w");
+    if( !f ) {
+        perror(full);
+        exit(1);
+    }
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(f, fmt, args);
+    va_end(args);
+    fclose(f);
+}
+
+static void
+make_fixture(int cores, int procs)
+{
+    snprintf(fixture, sizeof(fixture), "/tmp/gatotray-bench.XXXXXX");
+    if( !mkdtemp(fixture) ) {
+        perror("mkdtemp");
+        exit(1);
+    }
+
+    /* /proc/stat as a busy machine has it, with the long lines after cpu* */
+    char* stat = malloc(200*(cores+1) + 4096);
+    char* p = stat;
+    p += sprintf(p, "cpu  %d 1320 %d 98765432 4321 0 2345 0 0 0\n",
+                 cores*123456, cores*23456);
+    for(int i=0; i<cores; i++)
+        p += sprintf(p, "cpu%d %d 165 %d 12345679 540 0 293 0 0 0\n", i, 123456+i, 23456+i);
+    p += sprintf(p, "intr 123456789");
+    for(int i=0; i<512; i++)
+        p += sprintf(p, " %d", i%7 ? 0 : 1234*i);
+    p += sprintf(p, "\nctxt 987654321\nbtime 1300000000\nprocesses 123456\n"
+                    "procs_running 2\nprocs_blocked 0\nsoftirq 1234 0 1 2 3 4 5 6 7 8 9\n");
+    write_file("/proc/stat", "%s", stat);
+    free(stat);
+
+    for(int i=0; i<cores; i++) {
+        char dir[96];
+        snprintf(dir, sizeof(dir), "/sys/devices/system/cpu/cpufreq/policy%d", i);
+        char path[128];
+        snprintf(path, sizeof(path), "%s/scaling_min_freq", dir);
+        write_file(path, "800000\n");
+        snprintf(path, sizeof(path), "%s/scaling_max_freq", dir);
+        write_file(path, "3600000\n");
+        snprintf(path, sizeof(path), "%s/scaling_cur_freq", dir);
+        write_file(path, "%d\n", 1200000 + i*100000);
+    }
+
+    write_file("/sys/class/thermal/thermal_zone0/type", "acpitz\n");
+    write_file("/sys/class/thermal/thermal_zone0/temp", "40000\n");
+    write_file("/sys/class/thermal/thermal_zone1/type", "x86_pkg_temp\n");
+    write_file("/sys/class/thermal/thermal_zone1/temp", "52000\n");
+    write_file("/sys/class/hwmon/hwmon0/name", "coretemp\n");
+    write_file("/sys/class/hwmon/hwmon0/temp1_label", "Package id 0\n");
+    write_file("/sys/class/hwmon/hwmon0/temp1_input", "52000\n");
+    for(int i=0; i<cores && i<32; i++) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/class/hwmon/hwmon0/temp%d_label", i+2);
+        write_file(path, "Core %d\n", i);
+        snprintf(path, sizeof(path), "/sys/class/hwmon/hwmon0/temp%d_input", i+2);
+        write_file(path, "%d\n", 45000 + i*1000);
+    }
+    write_file("/sys/fs/cgroup/bench.slice/cpu.stat",
+               "usage_usec 123456789\nuser_usec 100000000\nsystem_usec 23456789\n"
+               "nr_periods 5000\nnr_throttled 120\nthrottled_usec 2345678\n");
+    write_file("/sys/fs/cgroup/bench.slice/cpu.max", "200000 100000\n");
+    /* One package with core, uncore and dram subzones, as powercap lists them */
+    static const char* zones[][2] = { { "intel-rapl:0", "package-0" }, { "intel-rapl:0:0", "core" },
+                                      { "intel-rapl:0:1", "uncore" }, { "intel-rapl:0:2", "dram" } };
+    for(int i=0; i<4; i++) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/class/powercap/%s/name", zones[i][0]);
+        write_file(path, "%s\n", zones[i][1]);
+        snprintf(path, sizeof(path), "/sys/class/powercap/%s/energy_uj", zones[i][0]);
+        write_file(path, "%d\n", 123456789 + i*1000);
+        snprintf(path, sizeof(path), "/sys/class/powercap/%s/max_energy_range_uj", zones[i][0]);
+        write_file(path, "262143328850\n");
+    }
+    write_file("/sys/class/powercap/intel-rapl:0/constraint_0_power_limit_uw", "15000000\n");
+    write_file("/sys/class/powercap/intel-rapl/enabled", "1\n");
+    write_file("/proc/meminfo", "MemTotal:       16303228 kB\nMemFree:         1873456 kB\n"
+               "MemAvailable:    9876544 kB\nBuffers:          412340 kB\nCached:          7012336 kB\n"
+               "SwapCached:        12044 kB\nActive:          6123400 kB\nSwapTotal:       8388604 kB\n"
+               "SwapFree:        8123456 kB\n");
+    /* Whole disks, their partitions and a loop device, which are skipped */
+    write_file("/proc/diskstats",
+               "   7       0 loop0 52 0 2118 17 0 0 0 0 0 40 17 0 0 0 0 0 0\n"
+               "   8       0 sda 123456 2345 9876543 45678 234567 34567 8765432 123456 0 234567 178901 0 0 0 0 4567 1234\n"
+               "   8       1 sda1 123000 2345 9870000 45600 234500 34567 8765000 123400 0 234500 178800 0 0 0 0 0 0\n"
+               " 259       0 nvme0n1 345678 123 23456789 56789 456789 234 34567890 67890 0 345678 124679 0 0 0 0 5678 2345\n"
+               " 259       1 nvme0n1p1 345600 123 23456000 56700 456700 234 34567000 67800 0 345600 124500 0 0 0 0 0 0\n");
+    write_file("/proc/net/dev",
+               "Inter-|   Receive                                                |  Transmit\n"
+               " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+               "    lo: 12345678   23456    0    0    0     0          0         0 12345678   23456    0    0    0     0       0          0\n"
+               "  eth0: 987654321  765432    0   12    0     0          0      1234 123456789  345678    0    0    0     0       0          0\n");
+    write_file("/proc/loadavg", "0.52 0.58 0.59 3/%d %d\n", procs, procs);
+    for(int pid=1; pid<=procs; pid++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+        write_file(path, "%d (worker %d) S 1 %d %d 0 -1 4194560 2153 0 12 0 %d %d 0 0 20 0 4 0 "
+                   "1234 123456789 4567 18446744073709551615 1 1 0 0 0 0 0 4096 17663 0 0 0 "
+                   "17 %d 0 0 0 0 0\n", pid, pid, pid, pid, pid*7, pid*3, pid%cores);
+    }
+    static const char* pressure[] = { "cpu", "io", "memory" };
+    for(int i=0; i<3; i++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/pressure/%s", pressure[i]);
+        write_file(path, "some avg10=1.25 avg60=0.80 avg300=0.40 total=%d\n"
+                   "full avg10=0.00 avg60=0.00 avg300=0.00 total=%d\n", 123456789, i ? 2345678 : 0);
+    }
+}
+
+static int
+remove_entry(const char* path, const struct stat* st, int flag, struct FTW* ftw)
+{
+    return remove(path);
+}
+
+/* Stages */
+
+/* cpu_usage() as of v1.1: a persistent FILE and fscanf() of the first line */
+static void
+op_cpu_usage_fscanf(void* ctx)
+{
+    static FILE* f = NULL;
+    static ull busy_prev = 0, total_prev = 0;
+    if( !f ) {
+        char path[128];
+        snprintf(path, sizeof(path), "%s/proc/stat", (const char*)ctx);
+        if( !(f = fopen(path, "r")) ) {
+            perror(path);
+            exit(1);
+        }
+    }
+    ull busy, nice, system, idle, iowait = 0, irq = 0, softirq = 0;
+    if( 4 > fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu",
+                   &busy, &nice, &system, &idle, &iowait, &irq, &softirq) )
+        exit(1);
+    fflush(f);
+    rewind(f);
+    busy += nice+system+irq+softirq;
+    ull total = busy+idle+iowait;
+    volatile int usage = total > total_prev ? 100*(busy-busy_prev)/(total-total_prev) : 0;
+    (void)usage;
+    busy_prev = busy;
+    total_prev = total;
+}
+
+static void op_cpu_usage(void* ctx) { cpu_usage(SCALE); }
+static void op_cpu_freq(void* ctx) { cpu_freq(); }
+static void op_cpu_temperature(void* ctx) { cpu_temperature(); }
+static void op_psi_read(void* ctx) { PSI_Stall psi[PSI_RESOURCES]; psi_read(psi, SCALE); }
+static void op_cgroup_usage(void* ctx) { int u, t; cgroup_usage(&u, &t, SCALE); }
+static void op_rapl_read(void* ctx) { RAPL_Power power; rapl_read(&power, SCALE); }
+static void op_mem_read(void* ctx) { Mem_Usage mem; mem_read(&mem, SCALE); }
+static void op_disk_read(void* ctx) { Disk_IO disk; disk_read(&disk, SCALE); }
+static void op_net_read(void* ctx) { Net_IO net; net_read(&net); }
+static void op_procs_scan(void* ctx) { ProcsTop top[PROCS_TOP]; procs_scan(top, PROCS_TOP, SCALE); }
+static void op_sampler_read(void* ctx) { sampler_read(ctx, SCALE); }
+
+static unsigned rng = 2463534242u;
+
+static int
+random_percent(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng % (SCALE+1);
+}
+
+typedef struct {
+    History* history;
+    int* values;
+    int n_series;
+    Renderer* renderer;
+    Palette palette;
+    RenderOptions options;
+    Sample sample;
+} Bench;
+
+static void
+next_sample(Bench* b)
+{
+    for(int s=0; s<b->n_series; s++)
+        b->values[s] = random_percent();
+    b->values[H_IOWAIT] /= 8;
+    b->values[H_IRQ] /= 16;
+    b->values[H_STEAL] /= 8;
+    history_push(b->history, b->values);
+}
+
+static void op_history_push(void* ctx) { next_sample(ctx); }
+
+static void
+op_history_columns(void* ctx)
+{
+    Bench* b = ctx;
+    history_columns(b->history, b->renderer->columns);
+}
+
+/* A whole repaint, as after a resize or a change of preferences */
+static void
+op_render_full(void* ctx)
+{
+    Bench* b = ctx;
+    b->renderer->stale = 1;
+    render(b->renderer, b->history, &b->palette, &b->options, 60, 0);
+}
+
+/* A regular tick: one more sample, then repaint what changed */
+static void
+op_render_tick(void* ctx)
+{
+    Bench* b = ctx;
+    next_sample(b);
+    render(b->renderer, b->history, &b->palette, &b->options, 40 + b->values[H_TEMP]/2, 0);
+}
+
+/* One tick of --tty: a new sample, then only the changed cells */
+static TtyRenderer* bench_tty;
+
+static void
+op_tty_tick(void* ctx)
+{
+    Bench* b = ctx;
+    size_t len;
+    next_sample(b);
+    tty_render(bench_tty, b->history, &b->palette, &b->options, &b->sample, &len);
+    __asm__ volatile("" : : "r"(len) : "memory");
+}
+
+/* A fork since the last scan, so /proc is listed again */
+static void
+op_procs_forked(void* ctx)
+{
+    static int last_pid = 1000000;
+    char loadavg[64];
+    int len = snprintf(loadavg, sizeof(loadavg), "0.52 0.58 0.59 3/%d %d\n", procs_count, ++last_pid);
+    if( pwrite(*(int*)ctx, loadavg, len, 0) != len )
+        exit(1);
+    op_procs_scan(NULL);
+}
+
+static void
+op_tooltip(void* ctx)
+{
+    Bench* b = ctx;
+    static const ProcsTop top[PROCS_TOP] = {
+        { 4242, 95, "firefox" }, { 1234, 40, "cc1plus" }, { 777, 12, "Xorg" },
+        { 31337, 5, "pulseaudio" }, { 1, 1, "systemd" }
+    };
+    char tip[1024];
+    render_tooltip(tip, sizeof(tip), &b->sample, top, PROCS_TOP, b->renderer->span);
+    __asm__ volatile("" : : "r"(tip) : "memory");
+}
+
+/* One sample streamed by an agent to local trays, and read by each */
+static AgentServer* bench_server;
+static AgentPeer bench_peers[4];
+
+static void
+op_agent_stream(void* ctx)
+{
+    Bench* b = ctx;
+    agent_publish(bench_server, &b->sample, SCALE);
+    for(int i=0; i<4; i++)
+        agent_receive(&bench_peers[i]);
+}
+
+/* A tick of the flight recorder, and a whole dump until it is on disk */
+static FlightRecorder* bench_flight;
+
+static void
+op_flight_record(void* ctx)
+{
+    Bench* b = ctx;
+    static const ProcsTop top[PROCS_TOP] = { { 4242, 95, "firefox" }, { 1234, 40, "cc1plus" } };
+    flight_record(bench_flight, &b->sample, &b->sample, SCALE, top, 2);
+}
+
+static void
+op_flight_dump(void* ctx)
+{
+    struct timespec ms = { 0, 1000000 };
+    flight_trigger(bench_flight, "bench");
+    while( !flight_dumped(bench_flight) )
+        nanosleep(&ms, NULL);
+}
+
+/* Simulated loads, usage at second t */
+static int load_idle(int t) { return random_percent() % 4; }
+static int load_flat(int t) { return 1; }
+static int load_busy(int t) { return 20 + random_percent()*80/SCALE; }
+/* Idle with a 10s build every 2 minutes */
+static int load_bursty(int t) { return t%120 < 10 ? 90 : random_percent() % 4; }
+
+/* Wakeups per minute of the tick scheduler over an hour of 'load'. From
+ * second 'off' on, if not negative, power saving is turned off and only
+ * the wakeups after that count. */
+static void
+simulate_schedule(const char* name, int (*load)(int), int off)
+{
+    Schedule s;
+    schedule_init(&s, SCHEDULE_MAX_INTERVAL);
+    int wakeups = 0, seconds = 3600, from = 0;
+    for(int t=0; t<seconds; wakeups++)
+    {
+        if( off >= 0 && t >= off && s.max_interval > 1 ) {
+            s.max_interval = 1;
+            wakeups = 0;
+            from = t;
+        }
+        /* Each tick reads the mean usage over the interval it covers */
+        int covered = s.interval, sum = 0;
+        for(int i=0; i<covered; i++)
+            sum += load(t+i);
+        t += covered;
+        schedule_next(&s, sum/covered, 50);
+    }
+    printf("{\"schedule\":\"%s\",\"wakeups_per_min\":%.1f}\n", name, wakeups*60./(seconds-from));
+}
+
+static void
+usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [-c CORES] [-p PROCS] [-t MS] [-R ROOT] [--check-kernels]\n"
+                    "  -c, --cores N     cores in the fixture tree (default 8)\n"
+                    "  -p, --procs N     processes in the fixture tree (default 5000)\n"
+                    "  -t, --time MS     minimum run time of each stage (default 200)\n"
+                    "  -R, --root DIR    sample below DIR instead of a fixture tree\n"
+                    "      --check-kernels  compare the AVX2 and default kernels, and exit\n", argv0);
+}
+
+/* Both clones of every bulk kernel over a few random inputs */
+static int
+check_kernels(void)
+{
+    int failed = 0;
+    for(unsigned seed=1; seed<=8; seed++) {
+        int h = history_check_kernels(seed*2463534242u);
+        int r = render_check_kernels(seed*2463534242u);
+        if( h < 0 || r < 0 ) {
+            printf("{\"check\":\"kernels\",\"skipped\":\"no AVX2 clones\"}\n");
+            return 0;
+        }
+        failed |= h || r;
+        printf("{\"check\":\"kernels\",\"seed\":%u,\"history_mismatches\":%d,"
+               "\"render_mismatches\":%d}\n", seed, h, r);
+    }
+    return failed;
+}
+
+int
+main(int argc, char* argv[])
+{
+    static const struct option options[] = {
+        { "cores", required_argument, NULL, 'c' },
+        { "procs", required_argument, NULL, 'p' },
+        { "time",  required_argument, NULL, 't' },
+        { "root",  required_argument, NULL, 'R' },
+        { "help",  no_argument,       NULL, 'h' },
+        { "check-kernels", no_argument, NULL, 'K' },
+        { NULL, 0, NULL, 0 }
+    };
+    int cores = 8, procs = 5000, opt;
+    const char* root = NULL;
+    while( (opt = getopt_long(argc, argv, "c:p:t:R:h", options, NULL)) != -1 )
+        switch( opt ) {
+            case 'c': cores = atoi(optarg); break;
+            case 'p': procs = atoi(optarg); break;
+            case 't': min_ns = atol(optarg) * 1000000LL; break;
+            case 'R': root = optarg; break;
+            case 'K': return check_kernels();
+            default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    if( cores < 1 || cores > SAMPLE_MAX_CORES || procs < 0 || min_ns <= 0 || optind < argc ) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if( !root ) {
+        make_fixture(cores, procs);
+        root = fixture;
+    }
+    if( sampler_init(root) < 0 ) {
+        fprintf(stderr, "%s: can't read %s/proc/stat: %s\n", argv[0], root, strerror(errno));
+        return 1;
+    }
+    cores = proc_stat_cpus < SAMPLE_MAX_CORES ? proc_stat_cpus : SAMPLE_MAX_CORES;
+
+    measure("cpu_usage_fscanf", 0, op_cpu_usage_fscanf, (void*)root);
+    measure("cpu_usage", 0, op_cpu_usage, NULL);
+    measure("cpu_freq", 0, op_cpu_freq, NULL);
+    measure("cpu_temperature", 0, op_cpu_temperature, NULL);
+    measure("psi_read", 0, op_psi_read, NULL);
+    measure("rapl_read", 0, op_rapl_read, NULL);
+    measure("mem_read", 0, op_mem_read, NULL);
+    measure("disk_read", 0, op_disk_read, NULL);
+    measure("net_read", 0, op_net_read, NULL);
+    if( cgroup_select("bench.slice") == 0 ) {
+        measure("cgroup_usage", 0, op_cgroup_usage, NULL);
+        cgroup_select(NULL);
+    }
+
+    /* Steady, then with a fork before every scan */
+    measure("procs_scan", procs, op_procs_scan, NULL);
+    char loadavg[128];
+    snprintf(loadavg, sizeof(loadavg), "%s/proc/loadavg", root);
+    int loadavg_fd = root == fixture ? open(loadavg, O_WRONLY) : -1;
+    if( loadavg_fd >= 0 ) {
+        measure("procs_forked", procs, op_procs_forked, &loadavg_fd);
+        close(loadavg_fd);
+    }
+    printf("{\"procs_tracked\":%d,\"procs_open_fds\":%d,\"procs_enumerations\":%d}\n",
+           procs_count, procs_open_fds, procs_enumerations);
+    procs_close();
+
+    Bench b;
+    measure("sampler_read", 0, op_sampler_read, &b.sample);
+
+    b.n_series = H_CORES+cores;
+    b.history = history_new(b.n_series);
+    b.values = malloc(b.n_series*sizeof(int));
+    b.renderer = renderer_new(cores);
+    if( !b.history || !b.values || !b.renderer )
+        return 1;
+    palette_build(&b.palette, render_default_colors, 1);
+    /* Fill history well beyond what the largest icon shows */
+    for(int i=0; i<1<<20; i++)
+        next_sample(&b);
+    measure("history_push", 0, op_history_push, &b);
+
+    static const int sizes[] = { 16, 22, 24, 32, 48, 64, 96, 128 };
+    for(int heatmap=0; heatmap<2; heatmap++)
+    {
+        b.options = (RenderOptions){ .peaks = 1, .heatmap = heatmap, .shade = H_FREQ, .strip = H_IOWAIT };
+        for(int i=0; i<sizeof(sizes)/sizeof(*sizes); i++)
+        {
+            uint32_t* pixels = malloc(sizes[i]*sizes[i]*sizeof(*pixels));
+            if( !pixels || renderer_resize(b.renderer, sizes[i], pixels) < 0 )
+                return 1;
+            if( !heatmap )
+                measure("history_columns", sizes[i], op_history_columns, &b);
+            measure(heatmap ? "render_full_heatmap" : "render_full", sizes[i], op_render_full, &b);
+            measure(heatmap ? "render_tick_heatmap" : "render_tick", sizes[i], op_render_tick, &b);
+            free(pixels);
+        }
+    }
+    measure("tooltip", 0, op_tooltip, &b);
+    b.options = (RenderOptions){ .peaks = 1, .shade = H_FREQ, .strip = H_IOWAIT };
+    for(int braille=0; braille<2; braille++)
+        if( (bench_tty = tty_new(cores, braille)) && tty_resize(bench_tty, 80, 12) == 0 ) {
+            measure(braille ? "tty_tick_braille" : "tty_tick", 80, op_tty_tick, &b);
+            tty_free(bench_tty);
+        }
+
+    char agent_path[64];
+    snprintf(agent_path, sizeof(agent_path), "/tmp/gatotray-bench-%d.sock", (int)getpid());
+    if( (bench_server = agent_serve(agent_path)) ) {
+        for(int i=0; i<4; i++)
+            if( agent_peer_init(&bench_peers[i], agent_path) < 0 || agent_connect(&bench_peers[i]) < 0 )
+                return 1;
+        measure("agent_stream", 4, op_agent_stream, &b);
+        for(int i=0; i<4; i++)
+            agent_disconnect(&bench_peers[i]);
+        agent_stop(bench_server);
+    }
+
+    /* Never triggered by the samples, dumps go to the fixture */
+    if( root == fixture && (bench_flight = flight_new(fixture, (FlightTrigger){ 0, 0, 0 })) ) {
+        measure("flight_record", FLIGHT_RING, op_flight_record, &b);
+        measure("flight_dump", FLIGHT_RING, op_flight_dump, &b);
+        printf("{\"flight_skipped\":%lu}\n", flight_skipped(bench_flight));
+        flight_free(bench_flight);
+    }
+
+    simulate_schedule("idle", load_idle, -1);
+    simulate_schedule("busy", load_busy, -1);
+    simulate_schedule("bursty", load_bursty, -1);
+    /* Should be back to 60 at once, however quiet */
+    simulate_schedule("flat_power_saving_off", load_flat, 600);
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    printf("{\"peak_rss_kb\":%ld}\n", ru.ru_maxrss);
+
+    renderer_free(b.renderer);
+    free(b.values);
+    history_free(b.history);
+    sampler_close();
+    if( root == fixture )
+        nftw(fixture, remove_entry, 16, FTW_DEPTH|FTW_PHYS);
+    return 0;
+}
@@ -0,0 +1,163 @@
+/* cgroup v2 collector, for watching one slice instead of the whole host.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * cpu.stat has cumulative microseconds of CPU time used, and of wall time
+ * spent throttled by cpu.max:
+ *   usage_usec 123456
+ *   ...
+ *   throttled_usec 2345
+ * Usage is the share of the quota in cpu.max ("QUOTA PERIOD", or "max
+ * PERIOD" when unlimited) that was used, or of the CPUs it may run on
+ * without one: those in cpuset.cpus.effective ("0-3,6"), else the online
+ * ones. A quota beyond those CPUs counts as them. The files stay open and
+ * are re-read with pread() on every sample.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "cpu_usage.h"
+
+static char cgroup[256];
+const char* cgroup_path = NULL; /* the cgroup watched, or NULL */
+
+static int stat_fd = -1, max_fd = -1, cpus_fd = -1;
+static ull usage_prev = 0, throttled_prev = 0;
+static long long cgroup_last = 0;
+
+/* Value of the line starting with 'key', or 0 */
+static ull
+stat_value(const char* buf, const char* key)
+{
+    size_t len = strlen(key);
+    for(const char* line = buf; line; line = strchr(line, '\n'))
+    {
+        if( *line == '\n' )
+            line++;
+        if( !strncmp(line, key, len) && line[len] == ' ' )
+            return strtoull(line+len+1, NULL, 10);
+    }
+    return 0;
+}
+
+static int
+cgroup_file(const char* file)
+{
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", cgroup, file);
+    return root_open(path);
+}
+
+int
+cgroup_select(const char* path)
+{
+    cgroup_close();
+    if( !path || !*path )
+        return 0;
+    /* Relative to the cgroup2 mount, unless given in full */
+    if( !strncmp(path, "/sys/fs/cgroup", 14) )
+        snprintf(cgroup, sizeof(cgroup), "%s", path);
+    else
+        snprintf(cgroup, sizeof(cgroup), "/sys/fs/cgroup/%s", path + (*path == '/'));
+    if( (stat_fd = cgroup_file("cpu.stat")) < 0 )
+        return -1;
+    max_fd = cgroup_file("cpu.max"); /* not there on the root cgroup */
+    cpus_fd = cgroup_file("cpuset.cpus.effective"); /* nor without cpuset */
+    cgroup_path = cgroup;
+
+    /* Prime the deltas, so the first sample covers from now on */
+    int usage, throttled;
+    cgroup_usage(&usage, &throttled, 1);
+    return 0;
+}
+
+/* CPUs the cgroup may run on */
+static int
+cgroup_cpus(void)
+{
+    char buf[1024];
+    ssize_t len = cpus_fd >= 0 ? pread(cpus_fd, buf, sizeof(buf)-1, 0) : -1;
+    int n = 0;
+    if( len > 0 ) {
+        buf[len] = '\0';
+        for(char* p = buf; (unsigned)(*p-'0') < 10; ) {
+            long first = strtol(p, &p, 10), last = first;
+            if( *p == '-' )
+                last = strtol(p+1, &p, 10);
+            if( last >= first )
+                n += last - first + 1;
+            if( *p == ',' )
+                p++;
+        }
+    }
+    if( !n )
+        n = proc_stat_online;
+    return n > 0 ? n : 1;
+}
+
+/* CPUs' worth of time the cgroup may use, times 'period' */
+static long long
+cgroup_quota(long long* period)
+{
+    char buf[64];
+    ssize_t len = max_fd >= 0 ? pread(max_fd, buf, sizeof(buf)-1, 0) : -1;
+    long long quota = 0;
+    *period = 1;
+    if( len > 0 ) {
+        buf[len] = '\0';
+        if( sscanf(buf, "%lld %lld", &quota, period) != 2 || *period <= 0 )
+            quota = 0, *period = 1; /* "max": unlimited */
+    }
+    long long cpus = cgroup_cpus() * *period;
+    return quota > 0 && quota < cpus ? quota : cpus;
+}
+
+int
+cgroup_usage(int* usage, int* throttled, int scale)
+{
+    *usage = *throttled = 0;
+    if( stat_fd < 0 )
+        return -1;
+    char buf[512];
+    ssize_t len = pread(stat_fd, buf, sizeof(buf)-1, 0);
+    if( len <= 0 ) /* removed along with its last process */
+        return -1;
+    buf[len] = '\0';
+    ull used = stat_value(buf, "usage_usec"), waited = stat_value(buf, "throttled_usec");
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    long long now = t.tv_sec*1000000LL + t.tv_nsec/1000, elapsed = now - cgroup_last;
+    if( cgroup_last && elapsed > 0 ) {
+        long long period, quota = cgroup_quota(&period);
+        long long u = used >= usage_prev ? (used - usage_prev)*scale*period/(elapsed*quota) : 0;
+        long long w = waited >= throttled_prev ? (waited - throttled_prev)*scale/elapsed : 0;
+        *usage = u > scale ? scale : u;
+        *throttled = w > scale ? scale : w;
+    }
+    usage_prev = used;
+    throttled_prev = waited;
+    cgroup_last = now;
+    return 0;
+}
+
+void
+cgroup_close(void)
+{
+    if( stat_fd >= 0 )
+        close(stat_fd);
+    if( max_fd >= 0 )
+        close(max_fd);
+    if( cpus_fd >= 0 )
+        close(cpus_fd);
+    stat_fd = max_fd = cpus_fd = -1;
+    cgroup_path = NULL;
+    cgroup_last = 0;
+}
@@ -7,177 +7,689 @@
  * Changelog:
  * v1.1:    Added support for /sys/class/thermal/thermal_zone0/temp
  *          available since Linux 2.6.26.
+ * v1.2:    Read all cpu lines of /proc/stat with pread() and a hand-written
+ *          parser instead of fscanf().
+ * v1.3:    Frequency from all cpufreq policies, over persistent fds.
+ * v1.4:    Scan all thermal zones and hwmon sensors, and pick the hottest,
+ *          the package one or a given one. Retry failing sensors.
+ * v1.5:    Built on its own behind cpu_usage.h, reading below a configurable
+ *          root, and reporting errors instead of exiting.
  */
+#define _XOPEN_SOURCE 700
 #include <stdio.h>
+#include <stdlib.h>
 #include <error.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
 
-typedef unsigned long long ull;
+#include "cpu_usage.h"
 
-typedef struct {
-    int usage;
-    int iowait;
-} CPU_Usage;
+static char root[PATH_MAX] = "";
 
-CPU_Usage
-cpu_usage(int scale)
+/* Periods are in seconds, as the sampler thread may call in at 100 Hz */
+static long long
+seconds_now(void)
 {
-    /* static stuff */
-    static ull cpu_busy_prev=0;
-    static ull cpu_iowait_prev=0;
-    static ull cpu_total_prev=0;
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec;
+}
 
-    static FILE *proc_stat = NULL;
-    if( !proc_stat ) {
-        if( !(proc_stat = fopen("/proc/stat", "r")))
-            error(1, errno, "Could not open /proc/stat");
+/* Prefixes 'path' with the root, into 'full' of PATH_MAX bytes */
+static int
+root_path(char* full, const char* path)
+{
+    size_t n = strlen(root), len = strlen(path);
+    if( n+len >= PATH_MAX ) {
+        errno = ENAMETOOLONG;
+        return 0;
     }
+    memcpy(full, root, n);
+    memcpy(full+n, path, len+1);
+    return 1;
+}
 
-    ull busy, nice, system, idle, total;
-    ull iowait=0, irq=0, softirq=0; /* New in Linux 2.6 */
-    if( 4 > fscanf(proc_stat, "cpu %Lu %Lu %Lu %Lu %Lu %Lu %Lu",
-                    &busy, &nice, &system, &idle, &iowait, &irq, &softirq))
-        error(1, errno, "Can't seem to read /proc/stat properly");
-    fflush(proc_stat);
-    rewind(proc_stat);
+int
+root_open(const char* path)
+{
+    char full[PATH_MAX];
+    return root_path(full, path) ? open(full, O_RDONLY) : -1;
+}
 
-    busy += nice+system+irq+softirq;
-    total = busy+idle+iowait;
+DIR*
+root_opendir(const char* path)
+{
+    char full[PATH_MAX];
+    return root_path(full, path) ? opendir(full) : NULL;
+}
 
-    CPU_Usage cpu;
+/* Last read of /proc/stat: [0] is the "cpu" line, [1+N] is "cpuN".
+ * CPUs without a line (offline) read as all zeros. */
+CPU_Times *proc_stat = NULL;
+int proc_stat_cpus = 0; /* highest N seen + 1 */
+int proc_stat_online = 0;
 
-    if( busy > cpu_busy_prev )
-        cpu.usage = (ull)scale * (busy - cpu_busy_prev)
-                    / (total - cpu_total_prev);
-    else
-        cpu.usage = 0;
+static inline const char*
+parse_ull(const char* p, ull* value)
+{
+    ull v = 0;
+    while( *p == ' ' ) p++;
+    for( ; (unsigned)(*p-'0') < 10; p++)
+        v = v*10 + (*p-'0');
+    *value = v;
+    return p;
+}
 
-    if( iowait > cpu_iowait_prev )
-        cpu.iowait = (ull)scale * (iowait - cpu_iowait_prev)
-                    / (total - cpu_total_prev);
-    else
-        cpu.iowait = 0;
+static int proc_stat_fd = -1, proc_stat_allocated = 0;
+static char* proc_stat_buf = NULL;
+static size_t proc_stat_size = 4096;
+
+/* Parses every cpu* line of /proc/stat into proc_stat[]. Returns 0 if the
+ * buffer ended before the cpu lines did, -1 when out of memory. */
+static int
+parse_proc_stat(const char* p, const char* end)
+{
+    int n = 0, online = 0; /* entries filled so far, cpuN lines */
+    for(;;)
+    {
+        if( end-p < 4 )
+            return 0;
+        if( p[0]!='c' || p[1]!='p' || p[2]!='u' )
+            break;
+        ull cpu = 0;
+        int i = 0;
+        p += 3;
+        if( *p != ' ' ) {
+            p = parse_ull(p, &cpu);
+            i = cpu+1;
+            online++;
+        }
+        if( i >= proc_stat_allocated ) {
+            CPU_Times* grown = realloc(proc_stat, (i+1)*sizeof(*proc_stat));
+            if( !grown )
+                return -1;
+            proc_stat = grown;
+            proc_stat_allocated = i+1;
+        }
+        if( i > proc_stat_cpus )
+            proc_stat_cpus = i;
+        for( ; n < i; n++ ) /* skipped CPUs are offline */
+            for(int f=0; f<CPU_FIELDS; f++)
+                proc_stat[n].time[f] = 0;
+        for(int f=0; f<CPU_FIELDS; f++)
+            p = parse_ull(p, &proc_stat[i].time[f]);
+        n = i+1;
+        while( p < end && *p != '\n' ) p++;
+        if( p++ == end )
+            return 0;
+    }
+    for( ; n <= proc_stat_cpus; n++ )
+        for(int f=0; f<CPU_FIELDS; f++)
+            proc_stat[n].time[f] = 0;
+    proc_stat_online = online;
+    return 1;
+}
 
-    cpu_busy_prev = busy;
-    cpu_iowait_prev = iowait;
-    cpu_total_prev = total;
+/* Reads /proc/stat from a persistent fd into a buffer that only ever grows */
+int
+proc_stat_read(void)
+{
+    if( proc_stat_fd < 0 && (proc_stat_fd = root_open("/proc/stat")) < 0 )
+        return -1;
+    for(;;)
+    {
+        if( !proc_stat_buf && !(proc_stat_buf = malloc(proc_stat_size)) )
+            return -1;
+        ssize_t len = pread(proc_stat_fd, proc_stat_buf, proc_stat_size-1, 0);
+        if( len <= 0 )
+            return -1;
+        proc_stat_buf[len] = '\0';
+        int parsed = parse_proc_stat(proc_stat_buf, proc_stat_buf+len);
+        if( parsed < 0 )
+            return -1;
+        if( parsed || len < proc_stat_size-1 )
+            break;
+        /* The cpu lines did not fit */
+        free(proc_stat_buf);
+        proc_stat_buf = NULL;
+        proc_stat_size *= 2;
+    }
+    return proc_stat ? 0 : -1;
+}
 
+/* Usage since 'prev', which gets updated to 'now'. Guest time is already
+ * counted as user and nice time, steal is not counted anywhere else. */
+CPU_Usage
+cpu_usage_delta(const CPU_Times* now, CPU_Times* prev, int scale)
+{
+    /* Some counters, e.g. iowait, may go backwards: those count as 0 */
+    ull d[CPU_FIELDS];
+    for(int f=0; f<CPU_FIELDS; f++)
+        d[f] = now->time[f] > prev->time[f] ? now->time[f] - prev->time[f] : 0;
+    ull irq = d[CPU_IRQ]+d[CPU_SOFTIRQ];
+    ull busy = d[CPU_USER]+d[CPU_NICE]+d[CPU_SYSTEM]+irq;
+    ull total = busy+d[CPU_IDLE]+d[CPU_IOWAIT]+d[CPU_STEAL];
+
+    CPU_Usage cpu = { 0, 0, 0, 0, 0 };
+    if( total )
+    {
+        cpu.usage = (ull)scale * busy / total;
+        cpu.iowait = (ull)scale * d[CPU_IOWAIT] / total;
+        cpu.irq = (ull)scale * irq / total;
+        cpu.steal = (ull)scale * d[CPU_STEAL] / total;
+        cpu.guest = (ull)scale * (d[CPU_GUEST]+d[CPU_GUEST_NICE]) / total;
+    }
+    *prev = *now;
     return cpu;
 }
 
+static CPU_Times usage_prev, *cores_prev = NULL;
+static int cores_allocated = 0;
+
+CPU_Usage
+cpu_usage(int scale)
+{
+    CPU_Usage none = { 0, 0, 0, 0, 0 };
+    if( proc_stat_read() < 0 )
+        return none;
+    return cpu_usage_delta(&proc_stat[0], &usage_prev, scale);
+}
+
+/* Per-core usage from the last proc_stat_read(), into usage[0..n-1].
+ * Returns how many cores have been seen, which may be more than n. */
+int
+cpu_usage_cores(CPU_Usage* usage, int n, int scale)
+{
+    if( cores_allocated < proc_stat_cpus ) {
+        CPU_Times* grown = realloc(cores_prev, proc_stat_cpus*sizeof(*cores_prev));
+        if( !grown )
+            return 0;
+        for(cores_prev = grown; cores_allocated < proc_stat_cpus; cores_allocated++)
+            cores_prev[cores_allocated] = proc_stat[1+cores_allocated];
+    }
+    for(int i=0; i<n && i<proc_stat_cpus; i++)
+        usage[i] = cpu_usage_delta(&proc_stat[1+i], &cores_prev[i], scale);
+    return proc_stat_cpus;
+}
+
+/* Reads a small integer file from the start of a persistent fd */
+static int
+pread_long(int fd, long* value)
+{
+    char buf[32], *end;
+    ssize_t len = pread(fd, buf, sizeof(buf)-1, 0);
+    if( len <= 0 )
+        return 0;
+    buf[len] = '\0';
+    *value = strtol(buf, &end, 10);
+    return end != buf;
+}
+
+static int
+read_long(const char* path, long* value)
+{
+    int fd = root_open(path);
+    if( fd < 0 )
+        return 0;
+    int ok = pread_long(fd, value);
+    close(fd);
+    return ok;
+}
+
+typedef struct {
+    int id;       /* N of policyN, or -1 for the legacy cpu0/cpufreq */
+    int fd;       /* scaling_cur_freq, -1 while offline */
+    long min, max;
+} FreqPolicy;
+
+static FreqPolicy* freq_policies = NULL;
+static int freq_n_policies = 0;
+
+/* Overall scaling range, to normalize the results of cpu_freq() */
 int scaling_max_freq = 1;
 int scaling_min_freq = 0;
-int scaling_cur_freq = 0;
+int freq_online = 0; /* policies read on the last tick */
 
-int
-cpu_freq(void)
+static const char*
+policy_file(char* path, size_t size, const FreqPolicy* p, const char* file)
 {
-    static int active = 0;
-    static int errorstate = 0;
-    FILE *fp;
+    if( p->id < 0 )
+        snprintf(path, size, "/sys/devices/system/cpu/cpu0/cpufreq/%s", file);
+    else
+        snprintf(path, size, "/sys/devices/system/cpu/cpufreq/policy%d/%s", p->id, file);
+    return path;
+}
+
+static int
+open_freq_policy(FreqPolicy* p)
+{
+    char path[96];
+    p->fd = -1;
+    if( !read_long(policy_file(path, sizeof(path), p, "scaling_min_freq"), &p->min)
+     || !read_long(policy_file(path, sizeof(path), p, "scaling_max_freq"), &p->max)
+     || p->max <= p->min )
+        return 0;
+    p->fd = root_open(policy_file(path, sizeof(path), p, "scaling_cur_freq"));
+    return p->fd >= 0;
+}
 
-    if( !active ) /* Init time, read max & min */
+/* Finds new policies and reopens offline ones, leaving the rest untouched */
+static void
+scan_freq_policies(void)
+{
+    DIR* dir = root_opendir("/sys/devices/system/cpu/cpufreq");
+    struct dirent* entry;
+    int found = 0;
+    while( dir && (entry = readdir(dir)) )
     {
-        fp = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_min_freq", "r");
-        if(!fp) {
-            if(!errorstate) {
-                error(0, errno, "Can't get scaling frequencies");
-                errorstate = 1;
-            }
-            return 0;
+        int id;
+        if( 1 != sscanf(entry->d_name, "policy%d", &id) )
+            continue;
+        found++;
+        FreqPolicy* p = freq_policies;
+        while( p < freq_policies+freq_n_policies && p->id != id )
+            p++;
+        if( p == freq_policies+freq_n_policies ) {
+            FreqPolicy* grown = realloc(freq_policies, (freq_n_policies+1)*sizeof(*p));
+            if( !grown )
+                break;
+            freq_policies = grown;
+            p = &freq_policies[freq_n_policies++];
+            p->id = id;
+            p->fd = -1;
         }
-        if( 1 != fscanf(fp, "%u", &scaling_min_freq) ) {
-            fclose(fp);
-            scaling_min_freq = 0;
-            error(0, 0, "Can't get min scaling frequency");
-            return 0;
-        }
-        fclose(fp);
-        fp = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq", "r");
-        if(fp)
-        {
-            if( 1 != fscanf(fp, "%u", &scaling_max_freq) ) {
-                fclose(fp);
-                scaling_max_freq = 1;
-                scaling_min_freq = 0;
-                error(0, 0, "Can't get max scaling frequency");
-                return 0;
-            }
-            fclose(fp);
-            if( scaling_max_freq <= scaling_min_freq ) {
-                scaling_max_freq = 1;
-                scaling_min_freq = 0;
-                error(0, 0, "Wrong scaling frequencies!?");
-                return 0;
-            }
-        }
-        active = 1;
-        errorstate = 1;
+        if( p->fd < 0 )
+            open_freq_policy(p);
+    }
+    if(dir) closedir(dir);
+
+    /* Kernels before 4.3 only have per-cpu directories */
+    if( !found && !freq_n_policies
+     && (freq_policies = malloc(sizeof(*freq_policies))) ) {
+        freq_policies->id = -1;
+        freq_n_policies = 1;
+        open_freq_policy(freq_policies);
     }
 
-    fp = fopen("/sys/devices/system/cpu/cpu0/cpufreq/scaling_cur_freq", "r");
-    if(!fp || 1 != fscanf(fp, "%u", &scaling_cur_freq) )
+    scaling_min_freq = scaling_max_freq = 0;
+    for(FreqPolicy* p = freq_policies; p < freq_policies+freq_n_policies; p++)
     {
-        error(0, 0, "Can't get current processor frequency");
-        scaling_max_freq = 1;
+        if( p->fd < 0 ) continue;
+        if( !scaling_max_freq || p->min < scaling_min_freq ) scaling_min_freq = p->min;
+        if( p->max > scaling_max_freq ) scaling_max_freq = p->max;
+    }
+    if( scaling_max_freq <= scaling_min_freq ) {
         scaling_min_freq = 0;
-        scaling_cur_freq = 0;
-        active = 0;
+        scaling_max_freq = 1;
+    }
+}
+
+static int freq_errorstate = 0;
+static long long freq_scan_at = 0;
+
+CPU_Freq
+cpu_freq(void)
+{
+    CPU_Freq freq = { 0, 0, 0 };
+
+    /* Look for hotplugged policies every 30 seconds */
+    long long now = seconds_now();
+    if( now >= freq_scan_at ) {
+        scan_freq_policies();
+        freq_scan_at = now + 30;
+    }
+
+    long sum = 0;
+    freq_online = 0;
+    for(FreqPolicy* p = freq_policies; p < freq_policies+freq_n_policies; p++)
+    {
+        long cur;
+        if( p->fd < 0 )
+            continue;
+        if( !pread_long(p->fd, &cur) ) { /* Gone offline */
+            close(p->fd);
+            p->fd = -1;
+            continue;
+        }
+        if( !freq_online || cur < freq.min ) freq.min = cur;
+        if( cur > freq.max ) freq.max = cur;
+        sum += cur;
+        freq_online++;
+    }
+    if( freq_online ) {
+        freq.avg = sum / freq_online;
+        freq_errorstate = 0;
     }
+    else if( !freq_errorstate ) {
+        error(0, 0, "Can't get current processor frequency");
+        freq_errorstate = 1;
+    }
+    return freq;
+}
+
+static int
+read_string(const char* path, char* buf, size_t size)
+{
+    int fd = root_open(path);
+    if( fd < 0 )
+        return 0;
+    ssize_t len = read(fd, buf, size-1);
+    close(fd);
+    if( len <= 0 )
+        return 0;
+    while( len && (buf[len-1] == '\n' || buf[len-1] == ' ') )
+        len--;
+    buf[len] = '\0';
+    return 1;
+}
+
+/* Temperature sensors found by scan_thermal_sensors() */
+typedef struct {
+    char id[32];     /* thermal_zoneN, hwmonN/tempM or the ACPI zone */
+    char label[48];  /* zone type, or hwmon name and label */
+    int fd;
+    int legacy;      /* /proc/acpi "temperature: N C" format */
+    int package;     /* looks like the whole CPU package */
+    unsigned failures;
+    long long retry_at;  /* seconds_now() of the next try */
+} ThermalSensor;
+
+#define MAX_SENSORS 64
+static ThermalSensor sensors[MAX_SENSORS];
+static int n_sensors = 0;
 
-    if(fp) fclose(fp);
+/* Which sensor cpu_temperature() reports: "max" for the hottest one,
+ * "package" for the CPU package sensor, or a sensor id or label.
+ * Locked, as it may be changed while a sampler thread reads it. The lock
+ * also covers changes to sensors[], for cpu_temperature_sensor(). */
+static char temp_policy[48] = "package";
+static pthread_mutex_t temp_policy_lock = PTHREAD_MUTEX_INITIALIZER;
+static const char* temp_sensor = NULL; /* label of the sensor last reported */
 
-    return scaling_cur_freq;
+void
+cpu_temperature_select(const char* policy)
+{
+    pthread_mutex_lock(&temp_policy_lock);
+    snprintf(temp_policy, sizeof(temp_policy), "%s", policy && *policy ? policy : "package");
+    pthread_mutex_unlock(&temp_policy_lock);
 }
 
 int
-cpu_temperature(void)
+cpu_temperature_sensor(int i, char* label, size_t size)
+{
+    pthread_mutex_lock(&temp_policy_lock);
+    int found = i < n_sensors;
+    if( found )
+        snprintf(label, size, "%s", sensors[i].label);
+    pthread_mutex_unlock(&temp_policy_lock);
+    return found;
+}
+
+static void
+add_sensor(const char* path, const char* id, const char* label, int legacy)
 {
-    static enum { NOTHING = 0, SYS, PROC, UNKNOWN } found = UNKNOWN;
-    if( NOTHING == found ) return 0;
+    if( n_sensors == MAX_SENSORS )
+        return;
+    ThermalSensor* t = &sensors[n_sensors];
+    if( (t->fd = root_open(path)) < 0 )
+        return;
+    snprintf(t->id, sizeof(t->id), "%.31s", id);
+    snprintf(t->label, sizeof(t->label), "%.47s", label);
+    t->legacy = legacy;
+    t->package = strstr(label, "pkg") || strstr(label, "cpu") || strstr(label, "Package")
+              || strstr(label, "Tctl") || strstr(label, "Tdie");
+    t->failures = t->retry_at = 0;
+    n_sensors++;
+}
+
+static void
+scan_thermal_sensors(void)
+{
+    char path[PATH_MAX], label[48], name[32];
+    struct dirent* entry;
+    pthread_mutex_lock(&temp_policy_lock);
+    for(ThermalSensor* t = sensors; t < sensors+n_sensors; t++)
+        close(t->fd);
+    n_sensors = 0;
 
-    static FILE *acpi_temp = NULL;
-    if( !acpi_temp ) {
-        if( (acpi_temp = fopen("/sys/class/thermal/thermal_zone0/temp", "r")) )
+    DIR* dir = root_opendir("/sys/class/thermal");
+    while( dir && (entry = readdir(dir)) )
+    {
+        if( strncmp(entry->d_name, "thermal_zone", 12) )
+            continue;
+        snprintf(path, sizeof(path), "/sys/class/thermal/%s/type", entry->d_name);
+        if( !read_string(path, label, sizeof(label)) )
+            snprintf(label, sizeof(label), "%.47s", entry->d_name);
+        snprintf(path, sizeof(path), "/sys/class/thermal/%s/temp", entry->d_name);
+        add_sensor(path, entry->d_name, label, 0);
+    }
+    if(dir) closedir(dir);
+
+    dir = root_opendir("/sys/class/hwmon");
+    while( dir && (entry = readdir(dir)) )
+    {
+        if( strncmp(entry->d_name, "hwmon", 5) )
+            continue;
+        snprintf(path, sizeof(path), "/sys/class/hwmon/%s/name", entry->d_name);
+        if( !read_string(path, name, sizeof(name)) )
+            snprintf(name, sizeof(name), "%.31s", entry->d_name);
+        snprintf(path, sizeof(path), "/sys/class/hwmon/%s", entry->d_name);
+        DIR* hwmon = root_opendir(path);
+        struct dirent* input;
+        while( hwmon && (input = readdir(hwmon)) )
         {
-            found = SYS;
-        }
-        else {
-            error(0, errno, "Can't open /sys/class/thermal/thermal_zone0/temp");
-            if( (acpi_temp = fopen("/proc/acpi/thermal_zone/THM/temperature", "r"))
-            || (acpi_temp = fopen("/proc/acpi/thermal_zone/THM0/temperature", "r"))
-            || (acpi_temp = fopen("/proc/acpi/thermal_zone/THRM/temperature", "r")) )
-            {
-                found = PROC;
-            }
-            else {
-                error(0, errno, "Can't open /proc/acpi/thermal_zone/THxx/temperature");
-                found = NOTHING;
-                return 0;
-            }
+            int n, len = 0;
+            sscanf(input->d_name, "temp%d_input%n", &n, &len);
+            if( !len || input->d_name[len] )
+                continue;
+            char id[32], temp_label[32];
+            snprintf(id, sizeof(id), "%.16s/temp%d", entry->d_name, n);
+            snprintf(path, sizeof(path), "/sys/class/hwmon/%s/temp%d_label", entry->d_name, n);
+            if( read_string(path, temp_label, sizeof(temp_label)) )
+                snprintf(label, sizeof(label), "%.23s %.23s", name, temp_label);
+            else
+                snprintf(label, sizeof(label), "%.31s temp%d", name, n);
+            snprintf(path, sizeof(path), "/sys/class/hwmon/%s/%s", entry->d_name, input->d_name);
+            add_sensor(path, id, label, 0);
         }
+        if(hwmon) closedir(hwmon);
     }
+    if(dir) closedir(dir);
 
-    int T = 0;
-    if( SYS == found ) {
-        if(1!=fscanf(acpi_temp, "%d", &T)) {
-            error(0, errno, "Can't read temperature file.");
-            fclose(acpi_temp);
-            found = NOTHING;
-            return 0;
-        }
-        T /= 1000;
+    /* Before Linux 2.6.26 */
+    dir = n_sensors ? NULL : root_opendir("/proc/acpi/thermal_zone");
+    while( dir && (entry = readdir(dir)) )
+    {
+        if( entry->d_name[0] == '.' )
+            continue;
+        snprintf(path, sizeof(path), "/proc/acpi/thermal_zone/%s/temperature", entry->d_name);
+        add_sensor(path, entry->d_name, entry->d_name, 1);
     }
-    else if( PROC == found ) {
-        if(1!=fscanf(acpi_temp, "temperature: %d C", &T)) {
-            error(0, errno, "Can't read temperature file, wrong format?");
-            fclose(acpi_temp);
-            found = NOTHING;
-            return 0;
+    if(dir) closedir(dir);
+    pthread_mutex_unlock(&temp_policy_lock);
+}
+
+/* Degrees Celsius, or 0 if unavailable right now */
+static int
+read_sensor(ThermalSensor* t, long long now)
+{
+    if( t->retry_at > now )
+        return 0;
+
+    char buf[64];
+    ssize_t len = pread(t->fd, buf, sizeof(buf)-1, 0);
+    const char* p = buf;
+    if( len > 0 ) {
+        buf[len] = '\0';
+        if( t->legacy ) /* "temperature:  45 C" */
+            while( *p && *p != '-' && (unsigned)(*p-'0') >= 10 ) p++;
+    }
+    char* end;
+    long T = len > 0 ? strtol(p, &end, 10) : 0;
+    if( len <= 0 || end == p ) {
+        /* Back off exponentially, up to 5 minutes between retries */
+        if( !t->failures++ )
+            error(0, errno, "Can't read temperature from %s", t->id);
+        t->retry_at = now + (t->failures < 9 ? 1u<<t->failures : 300);
+        return 0;
+    }
+    t->failures = 0;
+    return t->legacy ? T : T/1000;
+}
+
+static long long rescan_at = 0;
+static unsigned rescans = 0;
+
+int
+cpu_temperature(void)
+{
+    long long now = seconds_now();
+
+    /* Nothing found, or every sensor failing: look again, less often each time */
+    int working = 0;
+    for(ThermalSensor* t = sensors; t < sensors+n_sensors; t++)
+        working += !t->failures;
+    if( working )
+        rescans = 0;
+    else if( now >= rescan_at ) {
+        scan_thermal_sensors();
+        rescan_at = now + (rescans < 9 ? 1u<<rescans : 300);
+        if( !n_sensors && !rescans )
+            error(0, 0, "No temperature sensors found");
+        rescans++;
+    }
+
+    char policy[sizeof(temp_policy)];
+    pthread_mutex_lock(&temp_policy_lock);
+    memcpy(policy, temp_policy, sizeof(policy));
+    pthread_mutex_unlock(&temp_policy_lock);
+    int max = !strcmp(policy, "max"), package = !strcmp(policy, "package");
+    /* Without a package sensor, "package" means the hottest one */
+    int have_package = 0;
+    for(ThermalSensor* t = sensors; t < sensors+n_sensors; t++)
+        have_package |= t->package;
+
+    int hottest = 0;
+    temp_sensor = NULL;
+    for(ThermalSensor* t = sensors; t < sensors+n_sensors; t++)
+    {
+        if( !(max || (package && (t->package || !have_package))
+              || !strcmp(policy, t->id) || !strcmp(policy, t->label)) )
+            continue;
+        int T = read_sensor(t, now);
+        if( T > hottest ) {
+            hottest = T;
+            temp_sensor = t->label;
         }
     }
-    rewind(acpi_temp);
-    fflush(acpi_temp);
+    return hottest;
+}
+
+int
+sampler_init(const char* sysroot)
+{
+    snprintf(root, sizeof(root), "%s", sysroot ? sysroot : "");
+    /* Prime the deltas, so the first sample covers from now on */
+    if( proc_stat_read() < 0 )
+        return -1;
+    usage_prev = proc_stat[0];
+    cpu_usage_cores(NULL, 0, 1);
+    cpu_temperature(); /* discover sensors, so they can be listed */
+    PSI_Stall psi[PSI_RESOURCES];
+    psi_read(psi, 1);
+    RAPL_Power power;
+    rapl_read(&power, 1);
+    Disk_IO disk;
+    disk_read(&disk, 1);
+    Net_IO net;
+    net_read(&net);
+    return 0;
+}
+
+int
+cpu_freq_scaled(int freq, int min_freq, int max_freq, int scale)
+{
+    if( !freq || max_freq <= min_freq )
+        return 0;
+    long long f = (long long)(freq - min_freq) * scale / (max_freq - min_freq);
+    return f < 0 ? 0 : f > scale ? scale : f;
+}
+
+static int
+scale_freq(int freq, int scale)
+{
+    return cpu_freq_scaled(freq, scaling_min_freq, scaling_max_freq, scale);
+}
+
+int
+sampler_read(Sample* sample, int scale)
+{
+    if( proc_stat_read() < 0 )
+        return -1;
+    sample->cpu = cpu_usage_delta(&proc_stat[0], &usage_prev, scale);
+    sample->cgroup = cgroup_path;
+    sample->throttled = 0;
+    if( cgroup_path )
+        cgroup_usage(&sample->cpu.usage, &sample->throttled, scale);
+    sample->n_cores = proc_stat_cpus < SAMPLE_MAX_CORES ? proc_stat_cpus : SAMPLE_MAX_CORES;
+    cpu_usage_cores(sample->core, sample->n_cores, scale);
+
+    sample->freq = cpu_freq();
+    sample->freq_avg = scale_freq(sample->freq.avg, scale);
+    sample->freq_max = scale_freq(sample->freq.max, scale);
+
+    sample->temp = cpu_temperature();
+    snprintf(sample->temp_sensor, sizeof(sample->temp_sensor), "%s", temp_sensor ? temp_sensor : "");
+
+    sample->psi_available = psi_read(sample->psi, scale);
+    rapl_read(&sample->power, scale);
+    mem_read(&sample->mem, scale);
+    disk_read(&sample->disk, scale);
+    net_read(&sample->net);
+    return 0;
+}
+
+void
+sampler_close(void)
+{
+    if( proc_stat_fd >= 0 )
+        close(proc_stat_fd);
+    proc_stat_fd = -1;
+    free(proc_stat_buf);
+    proc_stat_buf = NULL;
+    free(proc_stat);
+    proc_stat = NULL;
+    proc_stat_allocated = proc_stat_cpus = proc_stat_online = 0;
+    free(cores_prev);
+    cores_prev = NULL;
+    cores_allocated = 0;
+
+    for(FreqPolicy* p = freq_policies; p < freq_policies+freq_n_policies; p++)
+        if( p->fd >= 0 )
+            close(p->fd);
+    free(freq_policies);
+    freq_policies = NULL;
+    freq_n_policies = freq_online = freq_errorstate = 0;
+    freq_scan_at = 0;
+    scaling_min_freq = 0;
+    scaling_max_freq = 1;
+
+    pthread_mutex_lock(&temp_policy_lock);
+    for(ThermalSensor* t = sensors; t < sensors+n_sensors; t++)
+        close(t->fd);
+    n_sensors = 0;
+    pthread_mutex_unlock(&temp_policy_lock);
+    rescan_at = rescans = 0;
+    temp_sensor = NULL;
 
-    return T;
+    psi_close();
+    rapl_close();
+    system_close();
+    cgroup_close();
 }
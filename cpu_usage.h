@@ -0,0 +1,148 @@
+/* CPU usage, frequency and temperature collectors.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Nothing here needs GTK. Every file is read below the root given to
+ * sampler_init(), so a fixture tree can stand in for /proc and /sys.
+ */
+#ifndef CPU_USAGE_H
+#define CPU_USAGE_H
+
+#include <stddef.h>
+#include <dirent.h>
+
+typedef unsigned long long ull;
+
+/* Shares of all the time /proc/stat accounts for, steal included */
+typedef struct {
+    int usage;   /* user, nice, system, irq and softirq */
+    int iowait;
+    int irq;     /* irq and softirq, part of usage */
+    int steal;   /* taken by the hypervisor for other guests */
+    int guest;   /* guest and guest_nice, running our own guests, part of usage */
+} CPU_Usage;
+
+/* Fields of a "cpu" line of /proc/stat, in file order */
+enum { CPU_USER, CPU_NICE, CPU_SYSTEM, CPU_IDLE, CPU_IOWAIT, CPU_IRQ,
+       CPU_SOFTIRQ, CPU_STEAL, CPU_GUEST, CPU_GUEST_NICE, CPU_FIELDS };
+
+typedef struct {
+    ull time[CPU_FIELDS]; /* missing fields read as 0 */
+} CPU_Times;
+
+/* Frequencies in kHz across all cpufreq policies */
+typedef struct {
+    int min, avg, max;
+} CPU_Freq;
+
+/* Pressure stall information: share of time some or all tasks were stalled
+ * waiting for each resource, from /proc/pressure */
+enum { PSI_CPU, PSI_IO, PSI_MEMORY, PSI_RESOURCES };
+
+typedef struct {
+    int some, full;
+} PSI_Stall;
+
+/* Power draw from the RAPL energy counters */
+typedef struct {
+    int package, dram; /* milliwatts */
+    int share;         /* package power out of its long-term limit, 0~scale */
+} RAPL_Power;
+
+/* Memory from /proc/meminfo */
+typedef struct {
+    int used;              /* not available, out of MemTotal, 0~scale */
+    int swap;              /* swap used out of SwapTotal, 0~scale */
+    ull available, swap_used; /* kB */
+} Mem_Usage;
+
+/* Throughput of whole disks, from /proc/diskstats, in bytes per second */
+typedef struct {
+    ull read, written;
+    int busy;              /* time the busiest disk was doing I/O, 0~scale */
+} Disk_IO;
+
+/* Throughput of every interface but lo, from /proc/net/dev, in bytes per second */
+typedef struct {
+    ull rx, tx;
+} Net_IO;
+
+#define SAMPLE_MAX_CORES 128
+
+/* One reading of every collector */
+typedef struct {
+    CPU_Usage cpu;
+    CPU_Freq freq;
+    int freq_avg, freq_max;  /* scaled within the overall scaling range */
+    int temp;                /* Celsius, 0 if unknown */
+    char temp_sensor[48];    /* label of the sensor read, or "" */
+    int psi_available;       /* 0 on kernels without PSI */
+    PSI_Stall psi[PSI_RESOURCES];
+    RAPL_Power power;        /* all 0 without RAPL */
+    Mem_Usage mem;
+    Disk_IO disk;
+    Net_IO net;
+    const char* cgroup;      /* cgroup whose usage this is, NULL for all */
+    int throttled;           /* share of time that cgroup was throttled */
+    int n_cores;             /* valid entries in core[] */
+    CPU_Usage core[SAMPLE_MAX_CORES];
+} Sample;
+
+/* Root of /proc and /sys, NULL or "" for the real ones. Returns -1 if
+ * /proc/stat can't be read, which is the one thing we can't do without. */
+int sampler_init(const char* root);
+/* Watch the usage of a cgroup v2, by path below /sys/fs/cgroup, instead of
+ * the whole host. NULL or "" goes back. Returns -1 if it has no cpu.stat. */
+int cgroup_select(const char* path);
+/* Fills 'sample' with values scaled to 0~scale. Returns -1 on failure. */
+int sampler_read(Sample* sample, int scale);
+void sampler_close(void);
+
+/* Open 'path' below the root given to sampler_init(), for the collectors */
+int root_open(const char* path);
+DIR* root_opendir(const char* path);
+
+/* The collectors behind sampler_read() */
+extern CPU_Times *proc_stat;
+extern int proc_stat_cpus;
+extern int proc_stat_online; /* cpuN lines in the last read */
+int proc_stat_read(void);
+CPU_Usage cpu_usage_delta(const CPU_Times* now, CPU_Times* prev, int scale);
+CPU_Usage cpu_usage(int scale);
+int cpu_usage_cores(CPU_Usage* usage, int n, int scale);
+
+extern int scaling_max_freq, scaling_min_freq, freq_online;
+CPU_Freq cpu_freq(void);
+/* 'freq' within min_freq~max_freq, as 0~scale */
+int cpu_freq_scaled(int freq, int min_freq, int max_freq, int scale);
+
+void cpu_temperature_select(const char* policy);
+/* Copies the label of sensor 'i' for the preferences, as the sampler thread
+ * may rescan meanwhile. Returns 0 past the last one. */
+int cpu_temperature_sensor(int i, char* label, size_t size);
+int cpu_temperature(void);
+
+/* Stalls since the last call, scaled to 0~scale. Returns 0 without PSI. */
+int psi_read(PSI_Stall* stall, int scale);
+void psi_close(void);
+
+/* Power since the last call. Returns how many domains were read, 0 if none. */
+int rapl_read(RAPL_Power* power, int scale);
+void rapl_close(void);
+
+/* Memory now, and disk and network throughput since the last call.
+ * Return -1 if their file can't be read, leaving all 0. */
+int mem_read(Mem_Usage* mem, int scale);
+int disk_read(Disk_IO* disk, int scale);
+int net_read(Net_IO* net);
+void system_close(void);
+
+extern const char* cgroup_path;
+/* Usage of the cgroup_select()ed cgroup and share of time it was throttled,
+ * since the last call. Returns -1 if it can't be read. */
+int cgroup_usage(int* usage, int* throttled, int scale);
+void cgroup_close(void);
+
+#endif
@@ -0,0 +1,146 @@
+/* gatotray-export-reader: a minimal consumer of gatotray's shared memory.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Prints the latest values once, or every second with -w. --selftest N
+ * runs a writer flat out against reader threads for N seconds, checking
+ * that no snapshot ever mixes two writes.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "export.h"
+
+static void
+print_latest(const ExportSegment* s)
+{
+    if( !s->seconds ) {
+        puts("no samples yet");
+        return;
+    }
+    const ExportEntry* e = &s->history[(s->seconds-1) % EXPORT_HISTORY];
+    printf("usage %d%%\tiowait %d%%\tfreq %d MHz (%d~%d)\ttemp %d C (%s)\n",
+           e->usage, e->iowait, e->freq, s->freq_min, s->freq_max, e->temp,
+           *s->temp_sensor ? s->temp_sensor : "no sensor");
+}
+
+/* Self test: every field of a write is derived from the same counter */
+
+static volatile int selftest_running = 1;
+static const ExportSegment* selftest_seg;
+
+static void*
+selftest_reader(void* arg)
+{
+    unsigned long *stats = arg; /* snapshots, retries, torn */
+    ExportSegment copy;
+    while( selftest_running )
+    {
+        stats[1] += export_snapshot(selftest_seg, &copy);
+        stats[0]++;
+        if( !copy.seconds )
+            continue;
+        uint64_t k = copy.seconds;
+        const ExportEntry* e = &copy.history[(k-1) % EXPORT_HISTORY];
+        char sensor[48];
+        snprintf(sensor, sizeof(sensor), "%llu", (unsigned long long)k);
+        if( e->usage != k%100 || e->freq != k%30000 || copy.n_cores != k%SAMPLE_MAX_CORES
+         || copy.freq_max != (int32_t)k || strcmp(copy.temp_sensor, sensor) )
+            stats[2]++;
+    }
+    return NULL;
+}
+
+static int
+selftest(int seconds, int readers)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/gatotray-selftest-%d", (int)getpid());
+    ExportSegment* seg = export_create(name);
+    if( !seg || !(selftest_seg = export_attach(name)) ) {
+        perror("shm");
+        return 1;
+    }
+    pthread_t threads[readers];
+    unsigned long stats[readers][3];
+    memset(stats, 0, sizeof(stats));
+    for(int i=0; i<readers; i++)
+        pthread_create(&threads[i], NULL, selftest_reader, stats[i]);
+
+    Sample s = { .temp = 0 };
+    unsigned long writes = 0;
+    time_t end = time(NULL) + seconds;
+    while( time(NULL) < end )
+        for(int i=0; i<1000; i++) {
+            uint64_t k = seg->seconds + 1;
+            s.cpu.usage = k%100;
+            s.freq.avg = k%30000*1000;
+            s.freq.max = k*1000;
+            s.n_cores = k%SAMPLE_MAX_CORES;
+            snprintf(s.temp_sensor, sizeof(s.temp_sensor), "%llu", (unsigned long long)k);
+            export_publish(seg, &s, 100, 1);
+            writes++;
+        }
+    selftest_running = 0;
+
+    unsigned long total[3] = { 0, 0, 0 };
+    for(int i=0; i<readers; i++) {
+        pthread_join(threads[i], NULL);
+        for(int j=0; j<3; j++)
+            total[j] += stats[i][j];
+    }
+    export_detach(selftest_seg);
+    export_destroy(seg, name);
+    printf("%lu writes, %lu snapshots by %d readers, %lu retries, %lu torn\n",
+           writes, total[0], readers, total[1], total[2]);
+    return total[2] ? 1 : 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    static const struct option options[] = {
+        { "watch",    no_argument,       NULL, 'w' },
+        { "selftest", required_argument, NULL, 's' },
+        { "help",     no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int watch = 0, opt;
+    while( (opt = getopt_long(argc, argv, "ws:h", options, NULL)) != -1 )
+        switch( opt ) {
+            case 'w': watch = 1; break;
+            case 's': return selftest(atoi(optarg), 4);
+            default:
+                fprintf(stderr, "Usage: %s [-w] [--selftest SECONDS]\n", argv[0]);
+                return opt == 'h' ? 0 : 2;
+        }
+
+    char name[64];
+    export_name(name, sizeof(name));
+    const ExportSegment* seg = export_attach(name);
+    if( !seg ) {
+        fprintf(stderr, "%s: nothing exported at %s, is gatotray exporting?\n", argv[0], name);
+        return 1;
+    }
+    ExportSegment copy;
+    do {
+        /* A restarted gatotray exports a new segment under the same name */
+        const ExportSegment* again;
+        if( watch && seg->time < time(NULL) - 2 && (again = export_attach(name)) ) {
+            export_detach(seg);
+            seg = again;
+        }
+        export_snapshot(seg, &copy);
+        print_latest(&copy);
+        fflush(stdout);
+    } while( watch && !sleep(1) );
+    export_detach(seg);
+    return 0;
+}
@@ -0,0 +1,128 @@
+/* Latest samples and a short history in POSIX shared memory.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Seqlock: the writer makes 'seq' odd, writes, and makes it even again,
+ * with release fences in between. A reader copies everything between two
+ * acquire loads of 'seq' and retries unless both are the same even value.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "export.h"
+
+void
+export_name(char* name, size_t size)
+{
+    snprintf(name, size, "/gatotray-%u", (unsigned)getuid());
+}
+
+ExportSegment*
+export_create(const char* name)
+{
+    /* Always a fresh segment of our own: one left by another user could be
+     * truncated under us. In the sticky /dev/shm theirs can't be unlinked,
+     * and O_EXCL then fails. */
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0644);
+    if( fd < 0 )
+        return NULL;
+    ExportSegment* seg = MAP_FAILED;
+    if( !ftruncate(fd, sizeof(*seg)) )
+        seg = mmap(NULL, sizeof(*seg), PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if( seg == MAP_FAILED )
+        return NULL;
+    /* Readers ignore it until the magic is there */
+    __atomic_store_n(&seg->magic, 0, __ATOMIC_RELAXED);
+    seg->version = EXPORT_VERSION;
+    seg->size = sizeof(*seg);
+    seg->seq = 0;
+    seg->seconds = 0;
+    __atomic_store_n(&seg->magic, EXPORT_MAGIC, __ATOMIC_RELEASE);
+    return seg;
+}
+
+void
+export_publish(ExportSegment* seg, const Sample* s, int scale, int seconds)
+{
+    uint32_t seq = seg->seq;
+    __atomic_store_n(&seg->seq, seq+1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    ExportEntry e = {
+        .usage = s->cpu.usage*100/scale, .iowait = s->cpu.iowait*100/scale,
+        .freq = s->freq.avg/1000, .temp = s->temp,
+    };
+    for(int i=0; i<seconds; i++)
+        seg->history[seg->seconds++ % EXPORT_HISTORY] = e;
+    seg->time = time(NULL);
+    seg->freq_min = s->freq.min/1000;
+    seg->freq_max = s->freq.max/1000;
+    seg->n_cores = s->n_cores;
+    snprintf(seg->temp_sensor, sizeof(seg->temp_sensor), "%s", s->temp_sensor);
+
+    __atomic_store_n(&seg->seq, seq+2, __ATOMIC_RELEASE);
+}
+
+void
+export_destroy(ExportSegment* seg, const char* name)
+{
+    if( !seg )
+        return;
+    munmap(seg, sizeof(*seg));
+    shm_unlink(name);
+}
+
+const ExportSegment*
+export_attach(const char* name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if( fd < 0 )
+        return NULL;
+    /* Short until export_create() sizes it, and reading past the end is SIGBUS */
+    struct stat st;
+    const ExportSegment* seg = MAP_FAILED;
+    if( !fstat(fd, &st) && st.st_size >= sizeof(*seg) )
+        seg = mmap(NULL, sizeof(*seg), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if( seg == MAP_FAILED )
+        return NULL;
+    if( __atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != EXPORT_MAGIC
+     || seg->version != EXPORT_VERSION || seg->size != sizeof(*seg) ) {
+        munmap((void*)seg, sizeof(*seg));
+        return NULL;
+    }
+    return seg;
+}
+
+int
+export_snapshot(const ExportSegment* seg, ExportSegment* copy)
+{
+    for(int retries=0;; retries++)
+    {
+        uint32_t seq = __atomic_load_n(&seg->seq, __ATOMIC_ACQUIRE);
+        if( seq & 1 )
+            continue;
+        memcpy(copy, seg, sizeof(*copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if( __atomic_load_n(&seg->seq, __ATOMIC_RELAXED) == seq ) {
+            copy->seq = seq;
+            return retries;
+        }
+    }
+}
+
+void
+export_detach(const ExportSegment* seg)
+{
+    munmap((void*)seg, sizeof(*seg));
+}
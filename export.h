@@ -0,0 +1,59 @@
+/* Latest samples and a short history in POSIX shared memory.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * The segment is named "/gatotray-UID" and laid out as ExportSegment, in
+ * native byte order. Each writer creates it afresh, so readers that keep
+ * it mapped should attach again once it stops moving. Readers map it read-only and take consistent copies
+ * with export_snapshot(), a seqlock read: 'seq' is odd while the writer is
+ * at it, and changes whenever the contents do. No locks, no system calls.
+ */
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu_usage.h"
+
+#define EXPORT_MAGIC 0x4f544147 /* "GATO" */
+#define EXPORT_VERSION 1
+#define EXPORT_HISTORY 64 /* seconds */
+
+typedef struct {
+    int16_t usage, iowait; /* percent */
+    int16_t freq;          /* MHz, average of all policies */
+    int16_t temp;          /* Celsius, 0 if unknown */
+} ExportEntry;
+
+typedef struct {
+    uint32_t magic, version;
+    uint32_t size;          /* of the whole segment */
+    uint32_t seq;
+    uint64_t seconds;       /* entries published so far */
+    int64_t time;           /* time() of the last one */
+    int32_t freq_min, freq_max; /* MHz of the slowest and fastest policy */
+    int32_t n_cores;
+    char temp_sensor[48];
+    /* One entry per second, entry i at history[i % EXPORT_HISTORY]; the
+     * latest is at (seconds-1) % EXPORT_HISTORY */
+    ExportEntry history[EXPORT_HISTORY];
+} ExportSegment;
+
+/* "/gatotray-UID" into 'name' */
+void export_name(char* name, size_t size);
+
+/* Writer side. export_publish() adds 'seconds' entries of the same sample. */
+ExportSegment* export_create(const char* name);
+void export_publish(ExportSegment* seg, const Sample* sample, int scale, int seconds);
+void export_destroy(ExportSegment* seg, const char* name);
+
+/* Reader side. Returns NULL if missing, not sized yet, or of another version. */
+const ExportSegment* export_attach(const char* name);
+/* Copies a consistent snapshot. Returns how many times it had to retry. */
+int export_snapshot(const ExportSegment* seg, ExportSegment* copy);
+void export_detach(const ExportSegment* seg);
+
+#endif
@@ -0,0 +1,265 @@
+/* Flight recorder, see flight.h.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Two rings of the same size: the tick fills 'ring', and a dump copies it
+ * into 'dump' for the writer thread, which owns it until it clears 'busy'.
+ * The lock is only held to hand over and to pick up the file name, never
+ * while writing.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "flight.h"
+
+struct FlightRecorder {
+    char dir[256];
+    FlightTrigger trigger;
+    FlightRecord ring[FLIGHT_RING];
+    unsigned n;                 /* records so far, the newest at (n-1)%FLIGHT_RING */
+    long long above_since;      /* ms when usage went above the trigger, or 0 */
+    long long cooldown;         /* ms before which nothing triggers */
+    int pending;                /* records to go before dumping, or -1 */
+    long long triggered;        /* ms of the trigger being recorded */
+    char reason[64];
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    int busy, stop;             /* under lock */
+    FlightRecord dump[FLIGHT_RING];
+    unsigned dump_n;
+    long long dump_ms;
+    char dump_reason[64];
+    char written[512];          /* under lock, the file just written */
+    int unseen;
+    unsigned long skipped;
+};
+
+static long long
+now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec*1000LL + ts.tv_nsec/1000000;
+}
+
+static void
+write_dump(FlightRecorder* f, char* path, size_t size)
+{
+    time_t t = f->dump_ms/1000;
+    struct tm tm;
+    char stamp[32], part[520];
+    localtime_r(&t, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    snprintf(path, size, "%s/flight-%s.tsv", f->dir, stamp);
+    /* Only complete files ever show up under the final name */
+    snprintf(part, sizeof(part), "%s.part", path);
+    FILE* file = fopen(part, "w");
+    if( !file ) {
+        *path = 0;
+        return;
+    }
+    strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+    fprintf(file, "# gatotray flight recording, triggered at %s by %s\n", stamp, f->dump_reason);
+    fprintf(file, "ms\tusage\tusage_max\tiowait\tirq\tsteal\tfreq\ttemp\ttop");
+    int n_cores = 0;
+    unsigned first = f->dump_n > FLIGHT_RING ? f->dump_n - FLIGHT_RING : 0;
+    for(unsigned i=first; i<f->dump_n; i++)
+        if( f->dump[i%FLIGHT_RING].n_cores > n_cores )
+            n_cores = f->dump[i%FLIGHT_RING].n_cores;
+    for(int c=0; c<n_cores; c++)
+        fprintf(file, "\tcpu%d", c);
+    fputc('\n', file);
+    for(unsigned i=first; i<f->dump_n; i++) {
+        const FlightRecord* r = &f->dump[i%FLIGHT_RING];
+        fprintf(file, "%lld\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t", r->ms - f->dump_ms,
+                r->usage, r->usage_max, r->iowait, r->irq, r->steal, r->freq, r->temp);
+        /* As comm:pid:percent, busiest first */
+        for(int p=0; p<r->n_top; p++)
+            fprintf(file, "%s%s:%d:%d", p ? "," : "", r->top[p].comm, r->top[p].pid, r->top[p].usage);
+        if( !r->n_top )
+            fputc('-', file);
+        for(int c=0; c<n_cores; c++)
+            fprintf(file, "\t%d", c < r->n_cores ? r->core[c] : 0);
+        fputc('\n', file);
+    }
+    if( (fclose(file) | rename(part, path)) != 0 ) {
+        remove(part);
+        *path = 0;
+    }
+}
+
+static void*
+flight_writer(void* arg)
+{
+    FlightRecorder* f = arg;
+    char path[512];
+    pthread_mutex_lock(&f->lock);
+    for(;;) {
+        while( !f->busy && !f->stop )
+            pthread_cond_wait(&f->wake, &f->lock);
+        if( !f->busy )
+            break;
+        pthread_mutex_unlock(&f->lock);
+        write_dump(f, path, sizeof(path));
+        pthread_mutex_lock(&f->lock);
+        if( *path ) {
+            strcpy(f->written, path);
+            f->unseen = 1;
+        }
+        f->busy = 0;
+    }
+    pthread_mutex_unlock(&f->lock);
+    return NULL;
+}
+
+FlightRecorder*
+flight_new(const char* dir, FlightTrigger trigger)
+{
+    FlightRecorder* f = calloc(1, sizeof(*f));
+    if( !f )
+        return NULL;
+    snprintf(f->dir, sizeof(f->dir), "%s", dir);
+    f->trigger = trigger;
+    f->pending = -1;
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->wake, NULL);
+    if( pthread_create(&f->thread, NULL, flight_writer, f) ) {
+        pthread_mutex_destroy(&f->lock);
+        pthread_cond_destroy(&f->wake);
+        free(f);
+        return NULL;
+    }
+    return f;
+}
+
+/* Hands the ring over to the writer, unless it is still at the last one */
+static void
+flight_dump(FlightRecorder* f)
+{
+    f->pending = -1;
+    pthread_mutex_lock(&f->lock);
+    if( f->busy )
+        f->skipped++;
+    else {
+        unsigned first = f->n > FLIGHT_RING ? f->n - FLIGHT_RING : 0;
+        for(unsigned i=first; i<f->n; i++)
+            f->dump[i%FLIGHT_RING] = f->ring[i%FLIGHT_RING];
+        f->dump_n = f->n;
+        f->dump_ms = f->triggered;
+        strcpy(f->dump_reason, f->reason);
+        f->busy = 1;
+        pthread_cond_signal(&f->wake);
+    }
+    pthread_mutex_unlock(&f->lock);
+}
+
+static int
+percent(int value, int scale)
+{
+    int p = value*100/scale;
+    return p < 0 ? 0 : p > 100 ? 100 : p;
+}
+
+int
+flight_record(FlightRecorder* f, const Sample* mean, const Sample* max, int scale,
+              const ProcsTop* top, int n_top)
+{
+    FlightRecord* r = &f->ring[f->n++ % FLIGHT_RING];
+    r->ms = now_ms();
+    r->usage = percent(mean->cpu.usage, scale);
+    r->usage_max = percent(max->cpu.usage, scale);
+    r->iowait = percent(mean->cpu.iowait, scale);
+    r->irq = percent(mean->cpu.irq, scale);
+    r->steal = percent(mean->cpu.steal, scale);
+    r->temp = max->temp < 0 ? 0 : max->temp > 255 ? 255 : max->temp;
+    r->freq = mean->freq.avg/1000;
+    r->n_cores = mean->n_cores > SAMPLE_MAX_CORES ? SAMPLE_MAX_CORES : mean->n_cores;
+    for(int i=0; i<r->n_cores; i++)
+        r->core[i] = percent(mean->core[i].usage, scale);
+    r->n_top = n_top < 0 ? 0 : n_top > PROCS_TOP ? PROCS_TOP : n_top;
+    for(int i=0; i<r->n_top; i++) {
+        r->top[i] = top[i];
+        r->top[i].usage = top[i].usage*100/scale;
+    }
+
+    if( f->pending > 0 && !--f->pending )
+        flight_dump(f);
+
+    /* Sustained usage counts from the first tick above the threshold */
+    const FlightTrigger* t = &f->trigger;
+    if( t->usage && r->usage >= t->usage ) {
+        if( !f->above_since )
+            f->above_since = r->ms;
+    }
+    else
+        f->above_since = 0;
+    if( f->pending >= 0 || r->ms < f->cooldown )
+        return 0;
+    if( t->temp && r->temp >= t->temp )
+        snprintf(f->reason, sizeof(f->reason), "temperature %d C >= %d C", r->temp, t->temp);
+    else if( f->above_since && r->ms - f->above_since >= t->seconds*1000LL )
+        snprintf(f->reason, sizeof(f->reason), "usage >= %d%% for %d s", t->usage, t->seconds);
+    else
+        return 0;
+    f->triggered = r->ms;
+    f->cooldown = r->ms + FLIGHT_COOLDOWN*1000LL;
+    f->pending = FLIGHT_AFTER;
+    return 1;
+}
+
+void
+flight_trigger(FlightRecorder* f, const char* reason)
+{
+    if( f->pending >= 0 || !f->n )
+        return;
+    snprintf(f->reason, sizeof(f->reason), "%s", reason);
+    f->triggered = f->ring[(f->n-1) % FLIGHT_RING].ms;
+    flight_dump(f);
+}
+
+const char*
+flight_dumped(FlightRecorder* f)
+{
+    static char path[512];
+    const char* dumped = NULL;
+    pthread_mutex_lock(&f->lock);
+    if( f->unseen ) {
+        strcpy(path, f->written);
+        f->unseen = 0;
+        dumped = path;
+    }
+    pthread_mutex_unlock(&f->lock);
+    return dumped;
+}
+
+unsigned long
+flight_skipped(const FlightRecorder* f)
+{
+    return f->skipped;
+}
+
+void
+flight_free(FlightRecorder* f)
+{
+    if( !f )
+        return;
+    /* What was recorded after a trigger is worth writing as it is */
+    if( f->pending >= 0 )
+        flight_dump(f);
+    pthread_mutex_lock(&f->lock);
+    f->stop = 1;
+    pthread_cond_signal(&f->wake);
+    pthread_mutex_unlock(&f->lock);
+    pthread_join(f->thread, NULL);
+    pthread_mutex_destroy(&f->lock);
+    pthread_cond_destroy(&f->wake);
+    free(f);
+}
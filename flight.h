@@ -0,0 +1,61 @@
+/* Flight recorder: the last few minutes in full, dumped to a file when a
+ * spike happens, so there is something to look at once it is over.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Each tick adds a record to a ring of FLIGHT_RING. Once triggered, it keeps
+ * FLIGHT_AFTER more records, then hands the whole ring to a thread that
+ * writes it out as "flight-YYYYmmdd-HHMMSS.tsv". The tick only ever copies
+ * the ring; a dump that comes while the last one is still being written is
+ * skipped. Triggers are at least FLIGHT_COOLDOWN seconds apart.
+ */
+#ifndef FLIGHT_H
+#define FLIGHT_H
+
+#include <stdint.h>
+
+#include "cpu_usage.h"
+#include "procs.h"
+
+#define FLIGHT_RING 256     /* records, over 4 minutes at 1 Hz */
+#define FLIGHT_AFTER 30     /* records kept after the trigger */
+#define FLIGHT_COOLDOWN 300 /* seconds */
+
+typedef struct {
+    int usage;   /* percent, 0 for none */
+    int seconds; /* that 'usage' must last */
+    int temp;    /* Celsius, 0 for none */
+} FlightTrigger;
+
+/* One tick, in the units the file shows */
+typedef struct {
+    long long ms;              /* since the epoch */
+    uint8_t usage, usage_max;  /* percent, average and peak over the tick */
+    uint8_t iowait, irq, steal, temp;
+    uint16_t freq;             /* MHz */
+    uint8_t n_cores, n_top;
+    uint8_t core[SAMPLE_MAX_CORES];
+    ProcsTop top[PROCS_TOP];
+} FlightRecord;
+
+typedef struct FlightRecorder FlightRecorder;
+
+/* Dumps into 'dir', which must exist. Returns NULL if out of memory or the
+ * writer thread can't be created. */
+FlightRecorder* flight_new(const char* dir, FlightTrigger trigger);
+/* Adds a tick, 'max' being its peak or the same as 'mean', and the busiest
+ * processes as procs_scan() gives them. Returns 1 if that triggered a dump. */
+int flight_record(FlightRecorder* f, const Sample* mean, const Sample* max, int scale,
+                  const ProcsTop* top, int n_top);
+/* Triggers a dump now, unless one is already on its way */
+void flight_trigger(FlightRecorder* f, const char* reason);
+/* The last file written, once, or NULL if none since the last call */
+const char* flight_dumped(FlightRecorder* f);
+/* Dumps skipped as the writer was busy */
+unsigned long flight_skipped(const FlightRecorder* f);
+/* Waits for a dump being written */
+void flight_free(FlightRecorder* f);
+
+#endif
@@ -0,0 +1,414 @@
+/* gatotray-cli: gatotray's collectors without the tray, for terminals,
+ * scripts and testing against fixture trees.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Prints one tab-separated line per sample:
+ *   usage% iowait% freq_avg_MHz freq_max_MHz temp_C sensor watts irq% steal%
+ *   mem% swap% disk_read disk_written disk_busy% rx tx [core%...]
+ * disk and network rates in bytes per second.
+ * With -g, usage is that of the cgroup and throttled% replaces iowait%.
+ *
+ * With --record FILE it also writes the raw readings to a trace, which
+ * gatotray-replay plays back through the tray's tick.
+ *
+ * With --tty it draws the tray's graph in the terminal instead, once per
+ * second, keeping history in the same file as the tray when it is free.
+ *
+ * With --serve ADDRESS it prints nothing and is an agent instead, streaming
+ * samples to trays on other hosts, see agent.h. --connect ADDRESS, which
+ * may be repeated, prints what agents stream, one line per record:
+ *   host usage% iowait% freq_MHz temp_C watts
+ *
+ * With --flight DIR it keeps a flight recorder as the tray does, dumping
+ * into DIR when --trigger USAGE,SECONDS,TEMP says so, see flight.h.
+ */
+#define _XOPEN_SOURCE 700
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include "cpu_usage.h"
+#include "agent.h"
+#include "flight.h"
+#include "procs.h"
+#include "export.h"
+#include "tty.h"
+#include "trace.h"
+
+static void
+usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [-r HZ] [-n COUNT] [-R ROOT] [-g CGROUP] [-c] [-e] [-W FILE] [-T[braille]]\n"
+                    "          [-S ADDRESS | -C ADDRESS...] [-F DIR [-t USAGE,SECONDS,TEMP]]\n"
+                    "  -r, --rate HZ     samples per second (default 1)\n"
+                    "  -n, --count N     stop after N samples (default: never)\n"
+                    "  -R, --root DIR    read /proc and /sys below DIR\n"
+                    "  -g, --cgroup PATH usage of a cgroup v2 below /sys/fs/cgroup,\n"
+                    "                    with throttling in place of iowait\n"
+                    "  -c, --cores       add one column per core\n"
+                    "  -e, --export      publish to shared memory, as gatotray does\n"
+                    "  -W, --record FILE write raw readings to a trace for gatotray-replay\n"
+                    "  -T, --tty[=braille]  draw the graph in the terminal, with blocks\n"
+                    "                    or braille, at 1 Hz\n"
+                    "  -S, --serve ADDRESS   stream samples to trays as an agent, on\n"
+                    "                    /unix/socket, host:port or :port\n"
+                    "  -C, --connect ADDRESS print what an agent streams, COUNT records\n"
+                    "  -F, --flight DIR  dump the last minutes into DIR on a spike\n"
+                    "  -t, --trigger USAGE,SECONDS,TEMP  usage%% for SECONDS, or Celsius,\n"
+                    "                    that make a spike (default 90,10,85)\n", argv0);
+}
+
+/* Terminal mode */
+
+static volatile sig_atomic_t tty_quit = 0, tty_winch = 1;
+static TtyRenderer* tty = NULL;
+static History* tty_history = NULL;
+static int* tty_values = NULL;
+static int tty_cores = 0;
+static Palette tty_palette;
+
+static void on_tty_quit(int signum) { tty_quit = 1; }
+static void on_tty_winch(int signum) { tty_winch = 1; }
+
+static void
+tty_write(const char* buf, size_t len)
+{
+    while( len ) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if( n < 0 && errno != EINTR )
+            return;
+        if( n > 0 )
+            buf += n, len -= n;
+    }
+}
+
+/* Keeps history where the tray does, if the tray is not using it */
+static History*
+tty_open_history(int n_series, const char* root)
+{
+    const char* cache = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+    char path[512];
+    if( root && *root )
+        return history_new(n_series);
+    if( cache && *cache )
+        snprintf(path, sizeof(path), "%s/gatotray", cache);
+    else if( home ) {
+        snprintf(path, sizeof(path), "%s/.cache", home);
+        mkdir(path, 0700);
+        strncat(path, "/gatotray", sizeof(path)-strlen(path)-1);
+    }
+    else
+        return history_new(n_series);
+    mkdir(path, 0700);
+    strncat(path, "/history", sizeof(path)-strlen(path)-1);
+    History* h = history_open(path, n_series, time(NULL));
+    return h ? h : history_new(n_series);
+}
+
+static int
+tty_start(int braille, const char* root)
+{
+    tty_cores = proc_stat_cpus < SAMPLE_MAX_CORES ? proc_stat_cpus : SAMPLE_MAX_CORES;
+    tty = tty_new(tty_cores, braille);
+    tty_history = tty_open_history(H_CORES+tty_cores, root);
+    tty_values = malloc((H_CORES+tty_cores)*sizeof(int));
+    if( !tty || !tty_history || !tty_values )
+        return -1;
+    /* Peaks blend towards black, as most terminals are dark */
+    RenderColor colors[COLORS];
+    memcpy(colors, render_default_colors, sizeof(colors));
+    colors[COLOR_BG] = (RenderColor){ 0, 0, 0 };
+    palette_build(&tty_palette, colors, 0);
+
+    struct sigaction sa = { .sa_handler = on_tty_quit };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = on_tty_winch;
+    sigaction(SIGWINCH, &sa, NULL);
+    /* Alternate screen, without cursor */
+    tty_write("\033[?1049h\033[?25l", 14);
+    return 0;
+}
+
+static void
+tty_tick(const Sample* s)
+{
+    render_sample(tty_values, s, tty_cores);
+    history_push(tty_history, tty_values);
+    if( tty_winch ) {
+        tty_winch = 0;
+        struct winsize ws;
+        if( ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) < 0 || !ws.ws_col || !ws.ws_row )
+            ws.ws_col = 80, ws.ws_row = 12;
+        if( tty_resize(tty, ws.ws_col, ws.ws_row) < 0 )
+            return;
+    }
+    RenderOptions options = { .peaks = 1, .shade = H_FREQ, .strip = H_IOWAIT };
+    size_t len;
+    const char* out = tty_render(tty, tty_history, &tty_palette, &options, s, &len);
+    tty_write(out, len);
+}
+
+static void
+tty_stop(void)
+{
+    if( tty )
+        tty_write("\033[0m\033[?25h\033[?1049l", 18);
+    tty_free(tty);
+    history_free(tty_history);
+    free(tty_values);
+}
+
+/* Client mode, as the tray watches agents */
+static int
+connect_agents(const char* argv0, const char** addresses, int n, long count)
+{
+    AgentPeer peers[AGENT_MAX_CLIENTS];
+    struct pollfd fds[AGENT_MAX_CLIENTS];
+    for(int i=0; i<n; i++)
+        if( agent_peer_init(&peers[i], addresses[i]) < 0 || agent_connect(&peers[i]) < 0 ) {
+            fprintf(stderr, "%s: can't connect to %s: %s\n", argv0, addresses[i], strerror(errno));
+            return 1;
+        }
+    printf("host\tusage\tiowait\tfreq\ttemp\twatts\n");
+    fflush(stdout);
+    for(int up = n; up && count; ) {
+        for(int i=0; i<n; i++)
+            fds[i] = (struct pollfd){ .fd = peers[i].fd, .events = POLLIN };
+        if( poll(fds, n, -1) < 0 && errno != EINTR )
+            break;
+        for(int i=0; i<n && count; i++) {
+            if( !fds[i].revents )
+                continue;
+            int records = agent_receive(&peers[i]);
+            if( records < 0 ) {
+                fprintf(stderr, "%s: %s went away\n", argv0, addresses[i]);
+                up--;
+                continue;
+            }
+            /* Several at once after a stall, the latest stands for them */
+            const AgentSample* s = &peers[i].last;
+            if( records ) {
+                printf("%s\t%d\t%d\t%d\t%d\t%d.%d\n", peers[i].host, s->usage, s->iowait,
+                       s->freq_mhz, s->temp, s->power_mw/1000, s->power_mw%1000/100);
+                fflush(stdout);
+                if( count > 0 )
+                    count--;
+            }
+        }
+    }
+    for(int i=0; i<n; i++)
+        agent_disconnect(&peers[i]);
+    return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+    static const struct option options[] = {
+        { "rate",  required_argument, NULL, 'r' },
+        { "count", required_argument, NULL, 'n' },
+        { "root",  required_argument, NULL, 'R' },
+        { "cgroup", required_argument, NULL, 'g' },
+        { "cores", no_argument,       NULL, 'c' },
+        { "export", no_argument,      NULL, 'e' },
+        { "record", required_argument, NULL, 'W' },
+        { "tty",   optional_argument, NULL, 'T' },
+        { "serve", required_argument, NULL, 'S' },
+        { "connect", required_argument, NULL, 'C' },
+        { "flight", required_argument, NULL, 'F' },
+        { "trigger", required_argument, NULL, 't' },
+        { "help",  no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    double rate = 1;
+    long count = -1;
+    const char* root = NULL, *cgroup = NULL, *record = NULL, *serve = NULL, *flight_dir = NULL;
+    FlightTrigger trigger = { 90, 10, 85 };
+    const char* agents[AGENT_MAX_CLIENTS];
+    int cores = 0, export = 0, tty_mode = 0, braille = 0, n_agents = 0, opt;
+    while( (opt = getopt_long(argc, argv, "r:n:R:g:ceW:T::S:C:F:t:h", options, NULL)) != -1 )
+        switch( opt ) {
+            case 'r': rate = atof(optarg); break;
+            case 'n': count = atol(optarg); break;
+            case 'R': root = optarg; break;
+            case 'g': cgroup = optarg; break;
+            case 'c': cores = 1; break;
+            case 'e': export = 1; break;
+            case 'W': record = optarg; break;
+            case 'T':
+                tty_mode = 1;
+                braille = optarg && !strcmp(optarg, "braille");
+                if( optarg && !braille && strcmp(optarg, "block") ) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'S': serve = optarg; break;
+            case 'F': flight_dir = optarg; break;
+            case 't':
+                if( sscanf(optarg, "%d,%d,%d", &trigger.usage, &trigger.seconds, &trigger.temp) != 3 ) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'C':
+                if( n_agents == AGENT_MAX_CLIENTS ) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                agents[n_agents++] = optarg;
+                break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    /* History ticks are seconds */
+    if( rate <= 0 || optind < argc || (tty_mode && rate != 1) || (serve && (tty_mode || n_agents)) ) {
+        usage(argv[0]);
+        return 2;
+    }
+    if( n_agents )
+        return connect_agents(argv[0], agents, n_agents, count);
+
+    if( sampler_init(root) < 0 ) {
+        fprintf(stderr, "%s: can't read %s/proc/stat: %s\n",
+                argv[0], root ? root : "", strerror(errno));
+        return 1;
+    }
+    if( cgroup_select(cgroup) < 0 ) {
+        fprintf(stderr, "%s: can't read cpu.stat of cgroup %s: %s\n",
+                argv[0], cgroup, strerror(errno));
+        return 1;
+    }
+
+    char name[64];
+    ExportSegment* seg = NULL;
+    export_name(name, sizeof(name));
+    if( export && !(seg = export_create(name)) ) {
+        fprintf(stderr, "%s: can't export to %s: %s\n", argv[0], name, strerror(errno));
+        return 1;
+    }
+
+    Trace* trace = NULL;
+    if( record && !(trace = trace_create(record, proc_stat_cpus)) ) {
+        fprintf(stderr, "%s: can't write %s: %s\n", argv[0], record, strerror(errno));
+        return 1;
+    }
+
+    FlightRecorder* flight = NULL;
+    if( flight_dir && !(flight = flight_new(flight_dir, trigger)) ) {
+        fprintf(stderr, "%s: can't start the flight recorder: %s\n", argv[0], strerror(errno));
+        return 1;
+    }
+
+    AgentServer* server = NULL;
+    if( serve && !(server = agent_serve(serve)) ) {
+        fprintf(stderr, "%s: can't serve on %s: %s\n", argv[0], serve, strerror(errno));
+        return 1;
+    }
+    /* Ctrl-C or SIGTERM end the loop below, so that traces get flushed,
+     * the export is unlinked and agents remove their Unix socket */
+    struct sigaction sa = { .sa_handler = on_tty_quit };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if( tty_mode && tty_start(braille, root) < 0 ) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+    else if( !tty_mode && !server ) {
+        printf("usage\t%s\tfreq\tfreq_max\ttemp\tsensor\twatts\tirq\tsteal"
+               "\tmem\tswap\tdisk_read\tdisk_written\tdisk_busy\trx\ttx", cgroup ? "throttled" : "iowait");
+        if( cores )
+            for(int i=0; i<proc_stat_cpus && i<SAMPLE_MAX_CORES; i++)
+                printf("\tcpu%d", i);
+        putchar('\n');
+        fflush(stdout);
+    }
+
+    /* Sleep to absolute deadlines, so the rate doesn't drift */
+    long long period = 1e9 / rate;
+    struct timespec next, start;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    start = next;
+    Sample s;
+    for(long n=0; (count < 0 || n < count) && !tty_quit; n++)
+    {
+        long long ns = next.tv_nsec + period;
+        next.tv_sec += ns / 1000000000;
+        next.tv_nsec = ns % 1000000000;
+        while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR && !tty_quit )
+            ;
+        if( tty_quit )
+            break;
+
+        if( sampler_read(&s, 100) < 0 ) {
+            tty_stop();
+            fprintf(stderr, "%s: sampling failed\n", argv[0]);
+            sampler_close();
+            export_destroy(seg, name);
+            agent_stop(server);
+            flight_free(flight);
+            return 1;
+        }
+        if( seg )
+            export_publish(seg, &s, 100, 1);
+        if( trace && trace_write(trace, (next.tv_sec-start.tv_sec)*1000LL
+                                 + (next.tv_nsec-start.tv_nsec)/1000000, &s) < 0 ) {
+            tty_stop();
+            fprintf(stderr, "%s: can't write %s: %s\n", argv[0], record, strerror(errno));
+            return 1;
+        }
+        if( flight ) {
+            ProcsTop top[PROCS_TOP];
+            int n_top = procs_scan(top, PROCS_TOP, 100);
+            flight_record(flight, &s, &s, 100, top, n_top < 0 ? 0 : n_top);
+            const char* dumped = flight_dumped(flight);
+            if( dumped )
+                fprintf(stderr, "%s: flight recording written to %s\n", argv[0], dumped);
+        }
+        if( server ) {
+            agent_publish(server, &s, 100);
+            continue;
+        }
+        if( tty_mode ) {
+            tty_tick(&s);
+            continue;
+        }
+        printf("%d\t%d\t%d\t%d\t%d\t%s", s.cpu.usage, s.cgroup ? s.throttled : s.cpu.iowait,
+               s.freq.avg/1000, s.freq.max/1000, s.temp,
+               *s.temp_sensor ? s.temp_sensor : "-");
+        printf("\t%d.%d\t%d\t%d", s.power.package/1000, s.power.package%1000/100,
+               s.cpu.irq, s.cpu.steal);
+        printf("\t%d\t%d\t%llu\t%llu\t%d\t%llu\t%llu", s.mem.used, s.mem.swap,
+               s.disk.read, s.disk.written, s.disk.busy, s.net.rx, s.net.tx);
+        if( cores )
+            for(int i=0; i<s.n_cores; i++)
+                printf("\t%d", s.core[i].usage);
+        putchar('\n');
+        fflush(stdout);
+    }
+    tty_stop();
+    sampler_close();
+    export_destroy(seg, name);
+    agent_stop(server);
+    flight_free(flight);
+    if( trace_close(trace) < 0 ) {
+        fprintf(stderr, "%s: can't write %s: %s\n", argv[0], record, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
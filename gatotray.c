@@ -18,37 +18,52 @@
  * TODO:
  * - Add "About" dialog with link to website.
  * - Refactor into headers+bodies.
- * - Refactor drawing code to reduce the chain pixmap-->pixbuf-->icon, specialy
- *   when transparency is enabled ... Check gdk_pixbuf_new_from_data() and
- *   gdk_pixbuf_from_pixdata().
  *
  */
 
-#define _XOPEN_SOURCE
+#define _XOPEN_SOURCE 700
 #include <sys/types.h>
+#include <stdlib.h>
 #include <signal.h>
+#include <string.h>
+#include <time.h>
 
 #include <gtk/gtk.h>
 #include <gdk/gdk.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
-#include "cpu_usage.c"
+#include "cpu_usage.h"
+#include "procs.h"
+#include "history.h"
+#include "render.h"
+#include "stats.h"
+#include "schedule.h"
+#include "sampler_thread.h"
+#include "export.h"
+#include "agent.h"
+#include "flight.h"
 #include "settings.c"
 #include "gatotray.xpm"
 
-#define SCALE 100
+Sample current;
+int n_cores = 0, *sample = NULL;
+/* With a sampler thread each tick folds many samples: these are their
+ * extremes, 'current' and 'sample' being the mean */
+SamplerThread *sampler_thread = NULL;
+int sampler_rate = 0;
+Sample current_min, current_max;
+/* Busiest processes, when the tooltip lists them */
+ProcsTop top[PROCS_TOP];
+int n_top = 0;
+int *sample_min = NULL, *sample_max = NULL;
+History *history = NULL;
+/* Agents on other hosts, streaming as gatotray-cli --serve */
+AgentPeer agents[AGENT_MAX_CLIENTS];
+int n_agents = 0, agents_retry = 0;
+
+int width = 0, timer = 0;
+Schedule schedule;
 
-typedef struct {
-    CPU_Usage cpu;
-    int freq;
-    int temp;
-} CPUstatus;
-
-CPUstatus* history = NULL;
-
-int width = 0, hist_size = 0, timer = 0;
-
-GdkPixmap *pixmap = NULL;
 GtkStatusIcon *app_icon = NULL;
 
 static void
@@ -57,146 +72,347 @@ popup_menu_cb(GtkStatusIcon *status_icon, guint button, guint time, GtkMenu* men
     gtk_menu_popup(menu, NULL, NULL, NULL, NULL, button, time);
 }
 
-GdkGC *gc = NULL;
-GdkPoint Termometer[] = {{2,16},{2,2},{3,1},{4,1},{5,2},{5,16},{6,17},{6,19},{5,20},
-    {2,20},{1,19},{1,17},{2,16}};
-#define Termometer_tube_size 6 /* first points are the 'tube' */
-#define Termometer_tube_start 2
-#define Termometer_tube_end 16
-#define Termometer_scale 22
-GdkPoint termometer_tube[Termometer_tube_size];
-GdkPoint termometer[sizeof(Termometer)/sizeof(*Termometer)];
+/* Latency of each stage of a tick, dumped on SIGUSR1 or from the menu */
+enum { T_SAMPLE, T_PROCS, T_HISTORY, T_RENDER, T_PIXBUF, T_TOOLTIP, T_TICK, TIMERS };
+StatsTimer timers[TIMERS] = {
+    { "sample" }, { "procs" }, { "history" }, { "render" }, { "pixbuf" }, { "tooltip" },
+    { "tick" }
+};
+volatile sig_atomic_t dump_stats = 0;
+
+static void
+on_sigusr1(int signum)
+{
+    dump_stats = 1;
+}
+
+static void
+show_diagnostics(void)
+{
+    gchar text[1024];
+    stats_format(text, sizeof(text), timers, TIMERS);
+    GtkWidget* dialog = gtk_message_dialog_new(NULL, 0, GTK_MESSAGE_INFO,
+                            GTK_BUTTONS_CLOSE, "%s diagnostics", GATOTRAY_VERSION);
+    gtk_message_dialog_format_secondary_markup(GTK_MESSAGE_DIALOG(dialog), "<tt>%s</tt>", text);
+    g_signal_connect(dialog, "response", G_CALLBACK(gtk_widget_destroy), NULL);
+    gtk_widget_show(dialog);
+}
+
+/* The icon is drawn straight into this RGBA buffer, wrapped by 'pixbuf' */
+Renderer *renderer = NULL;
+GdkPixbuf *pixbuf = NULL;
+int painted_prefs = -1;
 
 void redraw(void)
 {
-    gdk_gc_set_rgb_fg_color(gc, &bg_color);
-    gdk_draw_rectangle(pixmap, gc, TRUE, 0, 0, width, width);
-    
-    for(int i=0; i<width; i++)
-    {
-        CPUstatus* h = &history[width-1-i];
-        unsigned shade = h->freq * 99 / SCALE;
+    RenderOptions options = { pref_peaks, pref_heatmap,
+                              pref_shade_power ? H_POWER : pref_shade_max ? H_FREQ_MAX : H_FREQ,
+                              pref_strip ? H_PSI_SOME(pref_strip-1) : H_IOWAIT };
+    if( painted_prefs != pref_changes )
+        renderer->stale = TRUE;
+    painted_prefs = pref_changes;
+    long long t = stats_now();
+    /* The hottest host, when drawing the worst of all */
+    gboolean changed = render(renderer, history, &palette, &options, sample[H_TEMP], !(timer&1));
+    long long t2 = stats_now();
+    stats_record(&timers[T_RENDER], t2-t);
+    if( changed ) {
+        gtk_status_icon_set_from_pixbuf(GTK_STATUS_ICON(app_icon), pixbuf);
+        stats_record(&timers[T_PIXBUF], stats_now()-t2);
+    }
+}
 
-        /* Or shade by temperature:
-        shade = h->temp > 0 ? (h->temp < 100 ? h->temp : 99) : 0;
-        gdk_gc_set_rgb_fg_color(gc, &temp_gradient[shade]);
-        */
+gboolean
+resize_cb(GtkStatusIcon *app_icon, gint newsize, gpointer user_data)
+{
+    width = newsize;
+    /* The icon may still hold the old pixbuf, which frees its own pixels */
+    if(pixbuf) g_object_unref(pixbuf);
+    guint32 *pixels = g_new(guint32, width*width);
+    pixbuf = gdk_pixbuf_new_from_data((guchar*)pixels, GDK_COLORSPACE_RGB, TRUE, 8,
+                width, width, width*sizeof(*pixels), (GdkPixbufDestroyNotify)g_free, NULL);
+    if( renderer_resize(renderer, width, pixels) < 0 )
+        g_error("Out of memory");
 
-        /* Bottom blue strip for i/o waiting cycles: */
-        int iow_size = h->cpu.iowait*width/SCALE;
-        int bottom = width-iow_size;
-        if( iow_size ) {
-            gdk_gc_set_rgb_fg_color(gc, &iow_color);
-            gdk_draw_line(pixmap, gc, i, bottom, i, width);
-        }
+    redraw();
+    return TRUE;
+}
 
-        gdk_gc_set_rgb_fg_color(gc, &freq_gradient[shade]);
-        gdk_draw_line(pixmap, gc, i, bottom-(h->cpu.usage*width/SCALE), i, bottom);
+/* Built only when someone looks at it */
+gboolean
+query_tooltip_cb(GtkStatusIcon *app_icon, gint x, gint y, gboolean keyboard_mode,
+                 GtkTooltip *tooltip, gpointer user_data)
+{
+    long long t = stats_now();
+    gchar tip[2048];
+    int len = render_tooltip(tip, sizeof(tip), &current, top,
+                             pref_top_procs ? n_top : 0, renderer->span);
+    if( n_agents && len < sizeof(tip)-1 ) {
+        tip[len++] = '\n';
+        agent_tooltip(tip+len, sizeof(tip)-len, agents, n_agents, time(NULL));
     }
+    gtk_tooltip_set_text(tooltip, tip);
+    stats_record(&timers[T_TOOLTIP], stats_now()-t);
+    return TRUE;
+}
 
-    int T = history[0].temp;
-    if(T) /* Hide if 0, meaning it could not be read */
-    if( T<85 || (timer&1) ) /* Blink when hot! */
-    {
-        /* scale temp from 5~105 degrees Celsius to 0~100*/
-        T = (T-5)*100/100;
-        if(T<0) T=0;
-        if(T>99) T=99;
-        gdk_gc_set_rgb_fg_color(gc, &temp_gradient[T]);
-        gdk_draw_polygon(pixmap, gc, TRUE, termometer, sizeof(termometer)/sizeof(*termometer));
-        if( T<99 )
-        {
-            termometer_tube[0].y = (T*termometer[1].y+(99-T)*termometer[0].y)/99;
-            termometer_tube[Termometer_tube_size-1].y = termometer_tube[0].y;
-            gdk_gc_set_rgb_fg_color(gc, &bg_color);
-            gdk_draw_polygon(pixmap, gc, TRUE, termometer_tube, Termometer_tube_size);
+/* Shared memory for other local tools, while the preferences say so */
+ExportSegment *export_segment = NULL;
+gchar export_segment_name[64];
+
+static void
+export_sample(int seconds)
+{
+    if( pref_export && !export_segment ) {
+        export_name(export_segment_name, sizeof(export_segment_name));
+        if( !(export_segment = export_create(export_segment_name)) ) {
+            g_warning("Could not export to shared memory %s", export_segment_name);
+            pref_export = FALSE;
         }
-        gdk_gc_set_rgb_fg_color(gc, &fg_color);
-        gdk_draw_lines(pixmap, gc, termometer, sizeof(termometer)/sizeof(*termometer));
     }
-
-    GdkPixbuf *pixbuf =
-    gdk_pixbuf_get_from_drawable(NULL, pixmap, NULL, 0, 0, 0, 0, width, width);
-    if(pref_transparent) {
-        GdkPixbuf* new = gdk_pixbuf_add_alpha(pixbuf, TRUE, bg_color.red>>8
-                                        , bg_color.green>>8, bg_color.blue>>8);
-        g_object_unref(pixbuf);
-        pixbuf = new;
+    else if( !pref_export && export_segment ) {
+        export_destroy(export_segment, export_segment_name);
+        export_segment = NULL;
     }
-    gtk_status_icon_set_from_pixbuf(GTK_STATUS_ICON(app_icon), pixbuf);
-    g_object_unref(pixbuf);
+    if( export_segment )
+        export_publish(export_segment, &current, SCALE, seconds);
 }
 
-gboolean
-resize_cb(GtkStatusIcon *app_icon, gint newsize, gpointer user_data)
+/* Flight recorder, while the preferences say so, dumping into the cache */
+FlightRecorder *flight = NULL;
+gchar *cache_dir = NULL;
+
+static void
+record_flight(void)
 {
-    if(newsize > hist_size) {
-        history = g_realloc(history, newsize*sizeof(*history));
-        for(int i=hist_size; i<newsize; i++)
-            history[i] = history[hist_size-1];
-        hist_size = newsize;
+    if( pref_flight && !flight ) {
+        FlightTrigger trigger = { pref_flight_usage, pref_flight_seconds, pref_flight_temp };
+        if( !(flight = flight_new(cache_dir, trigger)) ) {
+            g_warning("Could not start the flight recorder");
+            pref_flight = FALSE;
+        }
     }
-    width = newsize;
+    else if( !pref_flight && flight ) {
+        flight_free(flight);
+        flight = NULL;
+    }
+    if( !flight )
+        return;
+    flight_record(flight, &current, sampler_thread ? &current_max : &current, SCALE, top, n_top);
+    const char* dumped = flight_dumped(flight);
+    if( dumped )
+        g_message("Flight recording written to %s", dumped);
+}
 
-    if(pixmap) g_object_unref(pixmap);
-    pixmap = gdk_pixmap_new(NULL, width, width, 24);
-    
-    if(gc)  g_object_unref(gc);
-    gc = gdk_gc_new(pixmap);
-    gdk_gc_set_line_attributes(gc, 1, GDK_LINE_SOLID, GDK_CAP_NOT_LAST, GDK_JOIN_MITER);
+/* Memory, disk and network icons, sharing the tick and the samples */
+typedef struct {
+    gboolean *pref;
+    const gchar *name;       /* of its history file */
+    GtkStatusIcon *icon;
+    History *history;
+    Renderer *renderer;
+    GdkPixbuf *pixbuf;
+    int *values;             /* mean, min and max, H_CORES each */
+} ExtraIcon;
+
+ExtraIcon extras[RENDER_EXTRAS] = {
+    { &pref_memory_icon, "history-memory" },
+    { &pref_disk_icon, "history-disk" },
+    { &pref_network_icon, "history-network" },
+};
+
+static void
+extra_redraw(ExtraIcon *e)
+{
+    RenderOptions options = { pref_peaks, FALSE, H_FREQ, H_IOWAIT };
+    if( render(e->renderer, e->history, &palette, &options, 0, 0) )
+        gtk_status_icon_set_from_pixbuf(e->icon, e->pixbuf);
+}
+
+static gboolean
+extra_resize_cb(GtkStatusIcon *icon, gint size, gpointer data)
+{
+    ExtraIcon *e = data;
+    if(e->pixbuf) g_object_unref(e->pixbuf);
+    guint32 *pixels = g_new(guint32, size*size);
+    e->pixbuf = gdk_pixbuf_new_from_data((guchar*)pixels, GDK_COLORSPACE_RGB, TRUE, 8,
+                size, size, size*sizeof(*pixels), (GdkPixbufDestroyNotify)g_free, NULL);
+    if( renderer_resize(e->renderer, size, pixels) < 0 )
+        g_error("Out of memory");
+    extra_redraw(e);
+    return TRUE;
+}
+
+static gboolean
+extra_tooltip_cb(GtkStatusIcon *icon, gint x, gint y, gboolean keyboard_mode,
+                 GtkTooltip *tooltip, gpointer data)
+{
+    ExtraIcon *e = data;
+    gchar tip[256];
+    render_extra_tooltip(tip, sizeof(tip), e-extras, &current, e->renderer->span);
+    gtk_tooltip_set_text(tooltip, tip);
+    return TRUE;
+}
 
-    for(int i=0; i<sizeof(termometer)/sizeof(*termometer); i++)
+/* Shows or hides extra icons as the preferences say, and feeds them */
+static void
+update_extras(int ticks)
+{
+    for(ExtraIcon *e = extras; e < extras+RENDER_EXTRAS; e++)
     {
-        termometer[i].x = Termometer[i].x*newsize/Termometer_scale;
-        termometer[i].y = Termometer[i].y*newsize/Termometer_scale;
-        if(i<Termometer_tube_size) {
-            termometer_tube[i].x = termometer[i].x;
-            termometer_tube[i].y = termometer[i].y;
+        if( *e->pref && !e->icon ) {
+            gchar *path = g_build_filename(cache_dir, e->name, NULL);
+            if( !(e->history = history_open(path, H_CORES, time(NULL))) )
+                e->history = history_new(H_CORES);
+            g_free(path);
+            e->renderer = renderer_new(0);
+            e->values = g_new0(int, 3*H_CORES);
+            if( !e->history || !e->renderer )
+                g_error("Out of memory");
+            e->icon = gtk_status_icon_new();
+            extra_resize_cb(e->icon, 1, e);
+            g_signal_connect(G_OBJECT(e->icon), "size-changed", G_CALLBACK(extra_resize_cb), e);
+            gtk_status_icon_set_has_tooltip(e->icon, TRUE);
+            g_signal_connect(G_OBJECT(e->icon), "query-tooltip", G_CALLBACK(extra_tooltip_cb), e);
+            gtk_status_icon_set_visible(e->icon, TRUE);
+        }
+        else if( !*e->pref && e->icon ) {
+            gtk_status_icon_set_visible(e->icon, FALSE);
+            g_object_unref(e->icon);
+            g_object_unref(e->pixbuf);
+            history_free(e->history);
+            renderer_free(e->renderer);
+            g_free(e->values);
+            *e = (ExtraIcon){ e->pref, e->name };
         }
+        if( !e->icon )
+            continue;
+
+        int *mean = e->values, *min = mean+H_CORES, *max = min+H_CORES;
+        render_extra(mean, e-extras, &current);
+        if( sampler_thread ) {
+            render_extra(min, e-extras, &current_min);
+            render_extra(max, e-extras, &current_max);
+            for(int i=0; i<ticks; i++)
+                history_push_folded(e->history, min, max, mean);
+        }
+        else for(int i=0; i<ticks; i++)
+            history_push(e->history, mean);
+        if( painted_prefs != pref_changes )
+            e->renderer->stale = TRUE;
+        extra_redraw(e);
     }
-    
-    redraw();
-    return TRUE;
+}
+
+/* Records from agents arrive between ticks, the latest kept for the next */
+static gboolean
+agent_cb(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    return agent_receive(data) >= 0;
+}
+
+/* Reconnects to agents that went down, every so often */
+static void
+watch_agents(void)
+{
+    if( timer < agents_retry )
+        return;
+    agents_retry = timer + 10;
+    for(AgentPeer* p = agents; p < agents+n_agents; p++)
+        if( p->state == AGENT_DOWN && agent_connect(p) >= 0 ) {
+            GIOChannel* channel = g_io_channel_unix_new(p->fd);
+            g_io_add_watch(channel, G_IO_IN|G_IO_HUP|G_IO_ERR, agent_cb, p);
+            g_io_channel_unref(channel);
+        }
+}
+
+/* Starts, stops or restarts the sampler thread as the preferences say */
+static void
+update_sampler_thread(void)
+{
+    if( pref_sampling_rate == sampler_rate )
+        return;
+    sampler_thread_stop(sampler_thread);
+    sampler_thread = NULL;
+    sampler_rate = pref_sampling_rate;
+    if( sampler_rate && !(sampler_thread = sampler_thread_start(sampler_rate, SCALE)) )
+        g_warning("Could not start the sampler thread, sampling on each tick");
+    /* Its ring only holds a couple of seconds: back to 1s ticks, which
+     * timeout_cb() re-arms for as the interval no longer matches */
+    if( sampler_thread )
+        schedule.interval = schedule.max_interval = 1;
 }
 
 int
 timeout_cb( gpointer data)
 {
-    timer++;
-    int i = hist_size-1;
-    while(i > 0) /* 'Smear' historic values */
-    {
-        #define smear(a,b) do{ \
-        int _a = a, _b = b, _factor = i*2; \
-        if( _a < _b ) _a++; \
-        a = ( _a*(_factor-1) + _b )/_factor; \
-        } while(0)
-
-        smear(history[i].cpu.usage, history[i-1].cpu.usage);
-        smear(history[i].cpu.iowait, history[i-1].cpu.iowait);
-        smear(history[i].freq, history[i-1].freq);
-        smear(history[i].temp, history[i-1].temp);
-
-        #undef smear
-        i--;
+    long long start = stats_now(), t = start, t2;
+    /* A stretched tick stands for that many seconds of the same reading */
+    int ticks = schedule.interval;
+    timer += ticks;
+    update_sampler_thread();
+    if( sampler_thread ) {
+        /* Without new samples, the last ones are repeated */
+        if( !sampler_thread_drain(sampler_thread, &current_min, &current_max, &current) )
+            current_min = current_max = current;
+    }
+    else if( sampler_read(&current, SCALE) < 0 )
+        g_warning("Could not read CPU status");
+    stats_record(&timers[T_SAMPLE], (t2 = stats_now())-t);
+
+    /* Busiest processes since the last tick, for the tooltip and for the
+     * flight recorder, which keeps them with every tick */
+    if( pref_top_procs || pref_flight )
+        n_top = MAX(procs_scan(top, PROCS_TOP, SCALE), 0);
+    else {
+        if( procs_count )
+            procs_close();
+        n_top = 0;
+    }
+    stats_record(&timers[T_PROCS], (t = stats_now())-t2);
+    t2 = t;
+
+    render_sample(sample, &current, n_cores);
+    watch_agents();
+    if( pref_agents_worst )
+        agent_worst(sample, agents, n_agents, time(NULL), SCALE);
+    if( sampler_thread ) {
+        render_sample(sample_min, &current_min, n_cores);
+        render_sample(sample_max, &current_max, n_cores);
+        if( pref_agents_worst )
+            agent_worst(sample_max, agents, n_agents, time(NULL), SCALE);
+        /* A stretched tick, while the thread starts, still fills its seconds */
+        for(int i=0; i<ticks; i++)
+            history_push_folded(history, sample_min, sample_max, sample);
     }
-    history[0].cpu = cpu_usage(SCALE);
-    int freq = cpu_freq();
-    history[0].freq = (freq - scaling_min_freq) * SCALE /
-                        (scaling_max_freq-scaling_min_freq);
-    history[0].temp = cpu_temperature();
+    else for(int i=0; i<ticks; i++)
+        history_push(history, sample);
+    export_sample(ticks);
+    record_flight();
+    stats_record(&timers[T_HISTORY], (t = stats_now())-t2);
 
+    update_extras(ticks);
     redraw();
+    stats_record(&timers[T_TICK], stats_now()-start);
+
+    if( dump_stats ) {
+        dump_stats = 0;
+        gchar text[1024];
+        stats_format(text, sizeof(text), timers, TIMERS);
+        g_message("Diagnostics:\n%s", text);
+        if( sampler_thread )
+            g_message("Sampler thread at %d Hz dropped %lu samples",
+                      sampler_rate, sampler_thread_dropped(sampler_thread));
+        if( flight )
+            g_message("Flight recorder skipped %lu dumps", flight_skipped(flight));
+    }
 
-    gchar* tip =
-    g_strdup_printf("CPU %d%% busy @ %d MHz, %d%%wa\n"
-                    "Temperature: %d C\n"
-                    "(click for 'top')"
-                    , history[0].cpu.usage*100/SCALE, freq/1000, history[0].cpu.iowait*100/SCALE
-                    , history[0].temp);
-    gtk_status_icon_set_tooltip(app_icon, tip);
-    g_free(tip);
-
+    /* The sampler thread keeps its own pace, no point in stretching ticks */
+    schedule.max_interval = pref_power_saving && !sampler_thread ? SCHEDULE_MAX_INTERVAL : 1;
+    if( schedule_next(&schedule, sample[H_USAGE], sample[H_TEMP]) != ticks ) {
+        g_timeout_add_seconds(schedule.interval, timeout_cb, NULL);
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -205,6 +421,10 @@ icon_activate(GtkStatusIcon *app_icon, gpointer user_data)
 {
     static GPid tops_pid = 0;
 
+    /* Whatever made the user click is likely in the last few minutes */
+    if( flight )
+        flight_trigger(flight, "click");
+
     if(tops_pid) {
         kill(tops_pid, SIGTERM);
         g_spawn_close_pid(tops_pid);
@@ -254,11 +474,41 @@ main( int   argc, char *argv[] )
     //~ g_object_get(gtk_pref_get_default(), "gtk-color-scheme", &cs, NULL);
     //~ g_message("gtk-color-scheme: %s", cs);
     
-    history = g_malloc(sizeof(*history));
-    history[0].cpu = cpu_usage(SCALE);
-    history[0].freq = 0;
-    history[0].temp = cpu_temperature();
-    hist_size = width = 1;
+    stats_now(); /* CPU share is reported from now on */
+    struct sigaction sa = { .sa_handler = on_sigusr1 };
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+
+    if( sampler_init(NULL) < 0 ) {
+        g_critical("Can't read /proc/stat");
+        return 1;
+    }
+    if( cgroup_select(pref_cgroup) < 0 )
+        g_message("Can't read /sys/fs/cgroup/%s/cpu.stat, watching the whole host", pref_cgroup);
+    n_cores = MIN(proc_stat_cpus, SAMPLE_MAX_CORES);
+    sample = g_new0(int, H_CORES+n_cores);
+    sample_min = g_new(int, H_CORES+n_cores);
+    sample_max = g_new(int, H_CORES+n_cores);
+    /* Keep history across restarts, or just in memory if that fails */
+    gchar* cache = g_build_filename(g_get_user_cache_dir(), "gatotray", NULL);
+    gchar* path = g_build_filename(cache, "history", NULL);
+    if( g_mkdir_with_parents(cache, 0700) < 0
+     || !(history = history_open(path, H_CORES+n_cores, time(NULL))) ) {
+        g_message("Could not keep history in %s", path);
+        history = history_new(H_CORES+n_cores);
+    }
+    g_free(path);
+    cache_dir = cache;
+    for(int i=0; i<pref_n_agents; i++)
+        if( agent_peer_init(&agents[n_agents], pref_agents[i]) < 0 )
+            g_message("Can't find agent %s, leaving it out", pref_agents[i]);
+        else
+            n_agents++;
+    renderer = renderer_new(n_cores);
+    if( !history || !renderer )
+        g_error("Out of memory");
+    width = 1;
 
     app_icon = gtk_status_icon_new();
     resize_cb(app_icon, width, NULL);
@@ -277,6 +527,11 @@ main( int   argc, char *argv[] )
     g_signal_connect(G_OBJECT (menuitem), "activate", show_pref_dialog, NULL);
     gtk_menu_shell_append(GTK_MENU_SHELL(menu), menuitem);
 
+    menuitem = gtk_image_menu_item_new_from_stock(GTK_STOCK_INFO, NULL);
+    gtk_menu_item_set_label(GTK_MENU_ITEM(menuitem), "Diagnostics");
+    g_signal_connect(G_OBJECT(menuitem), "activate", show_diagnostics, NULL);
+    gtk_menu_shell_append(GTK_MENU_SHELL(menu), menuitem);
+
     menuitem = gtk_image_menu_item_new_from_stock(GTK_STOCK_QUIT, NULL);
     g_signal_connect(G_OBJECT(menuitem), "activate", G_CALLBACK(gtk_main_quit), NULL);
     gtk_menu_shell_append(GTK_MENU_SHELL(menu), menuitem);
@@ -286,11 +541,18 @@ main( int   argc, char *argv[] )
     g_signal_connect(G_OBJECT(app_icon), "popup-menu", G_CALLBACK(popup_menu_cb), menu);
     g_signal_connect(G_OBJECT(app_icon), "size-changed", G_CALLBACK(resize_cb), NULL);
     g_signal_connect(G_OBJECT(app_icon), "activate", G_CALLBACK(icon_activate), NULL);
+    gtk_status_icon_set_has_tooltip(app_icon, TRUE);
+    g_signal_connect(G_OBJECT(app_icon), "query-tooltip", G_CALLBACK(query_tooltip_cb), NULL);
     gtk_status_icon_set_visible(app_icon, TRUE);
 
-    g_timeout_add(1000, timeout_cb, NULL);
+    /* Whole-second timers get woken up together with other processes' */
+    schedule_init(&schedule, pref_power_saving ? SCHEDULE_MAX_INTERVAL : 1);
+    update_sampler_thread();
+    g_timeout_add_seconds(1, timeout_cb, NULL);
 
     gtk_main();
+    sampler_thread_stop(sampler_thread);
+    flight_free(flight);
 
     return 0;
 }
@@ -0,0 +1,291 @@
+/* Logarithmic, multi-resolution history of samples.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Level k of the pyramid keeps the last HISTORY_RING buckets of 2^k samples,
+ * aligned to multiples of 2^k ticks. Every new sample lands in level 0, and
+ * each time two level k buckets complete they are merged into level k+1, so
+ * pushing costs O(1) amortized and O(log n) at worst. Buckets keep the min,
+ * max and sum of every series, so short spikes survive any amount of merging.
+ *
+ * history_columns() tiles time backwards from now with aligned buckets of
+ * growing size: a few per level, one more when needed to reach alignment.
+ * That gives every column an exact time span, growing exponentially.
+ *
+ * Storage is struct-of-arrays: min, max and sum are separate arrays with all
+ * series of a bucket contiguous, so merging runs over every series at once.
+ * Columns come out the other way round, one contiguous run per series.
+ *
+ * history_open() keeps the same arrays in a file mapped with MAP_SHARED, so
+ * pushing costs no system calls and the kernel writes them back as it sees
+ * fit. The header records when the file was last pushed to, so that the
+ * time in between shows as a gap once the file is adopted again.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "history.h"
+
+History*
+history_new(int n_series)
+{
+    size_t n = (size_t)HISTORY_LEVELS*HISTORY_RING*n_series;
+    History* h = calloc(1, sizeof(*h) + 3*n*sizeof(int));
+    if( !h ) return NULL;
+    h->n_series = n_series;
+    h->min = (int*)(h+1);
+    h->max = h->min + n;
+    h->sum = h->max + n;
+    h->fd = -1;
+    return h;
+}
+
+static int
+history_file_valid(const HistoryFile* f, int n_series, long long now)
+{
+    return !memcmp(f->magic, "gatohist", 8) && f->version == HISTORY_VERSION
+        && f->byte_order == 0x01020304 && f->n_series == n_series
+        && f->levels == HISTORY_LEVELS && f->ring == HISTORY_RING
+        && f->saved <= now && now - f->saved <= HISTORY_MAX_GAP;
+}
+
+History*
+history_open(const char* path, int n_series, long long now)
+{
+    size_t n = (size_t)HISTORY_LEVELS*HISTORY_RING*n_series;
+    size_t size = sizeof(HistoryFile) + 3*n*sizeof(int);
+    History* h = calloc(1, sizeof(*h));
+    if( !h )
+        return NULL;
+    h->n_series = n_series;
+    h->mapped = size;
+
+    /* One process per file: a second one keeps its history in memory */
+    struct flock lock = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+    struct stat st;
+    if( (h->fd = open(path, O_RDWR|O_CREAT|O_CLOEXEC, 0600)) < 0
+     || fcntl(h->fd, F_SETLK, &lock) < 0
+     || fstat(h->fd, &st) < 0
+     || (st.st_size != size && ftruncate(h->fd, size) < 0)
+     || (h->file = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, h->fd, 0)) == MAP_FAILED ) {
+        if( h->fd >= 0 )
+            close(h->fd);
+        free(h);
+        return NULL;
+    }
+    h->min = (int*)(h->file+1);
+    h->max = h->min + n;
+    h->sum = h->max + n;
+
+    HistoryFile* f = h->file;
+    if( st.st_size == size && history_file_valid(f, n_series, now) ) {
+        h->ticks = f->ticks;
+        /* The time it was not running is a gap, not the last reading */
+        int* empty = calloc(n_series, sizeof(int));
+        for(long long gap = now - f->saved; empty && gap > 0; gap--)
+            history_push(h, empty);
+        free(empty);
+    }
+    else {
+        memset(f, 0, size);
+        memcpy(f->magic, "gatohist", 8);
+        f->version = HISTORY_VERSION;
+        f->byte_order = 0x01020304;
+        f->n_series = n_series;
+        f->levels = HISTORY_LEVELS;
+        f->ring = HISTORY_RING;
+    }
+    f->saved = now;
+    return h;
+}
+
+void
+history_free(History* h)
+{
+    if( !h )
+        return;
+    if( h->file ) {
+        munmap(h->file, h->mapped);
+        close(h->fd);
+    }
+    free(h);
+}
+
+HistoryColumns*
+history_columns_new(int n_series, int n)
+{
+    size_t size = n*sizeof(unsigned) + 3*(size_t)n_series*n*sizeof(int);
+    HistoryColumns* c = calloc(1, sizeof(*c) + size);
+    if( !c ) return NULL;
+    c->n_series = n_series;
+    c->n = n;
+    c->count = (unsigned*)(c+1);
+    c->min = (int*)(c->count+n);
+    c->max = c->min + n_series*n;
+    c->mean = c->max + n_series*n;
+    return c;
+}
+
+static inline int*
+bucket(const History* h, int* a, int level, unsigned b)
+{
+    return a + ((size_t)level*HISTORY_RING + b%HISTORY_RING)*h->n_series;
+}
+
+static HISTORY_KERNEL void
+merge_min(int* restrict dst, const int* restrict a, const int* restrict z, int n)
+{
+    for(int s=0; s<n; s++)
+        dst[s] = a[s] < z[s] ? a[s] : z[s];
+}
+
+static HISTORY_KERNEL void
+merge_max(int* restrict dst, const int* restrict a, const int* restrict z, int n)
+{
+    for(int s=0; s<n; s++)
+        dst[s] = a[s] > z[s] ? a[s] : z[s];
+}
+
+static HISTORY_KERNEL void
+merge_sum(int* restrict dst, const int* restrict a, const int* restrict z, int n)
+{
+    for(int s=0; s<n; s++)
+        dst[s] = a[s] + z[s];
+}
+
+#ifdef HISTORY_KERNEL_CLONES
+/* Each clone, by the name GCC gives it */
+void merge_min_avx2(int*, const int*, const int*, int) __asm__("merge_min.avx2");
+void merge_min_default(int*, const int*, const int*, int) __asm__("merge_min.default");
+void merge_max_avx2(int*, const int*, const int*, int) __asm__("merge_max.avx2");
+void merge_max_default(int*, const int*, const int*, int) __asm__("merge_max.default");
+void merge_sum_avx2(int*, const int*, const int*, int) __asm__("merge_sum.avx2");
+void merge_sum_default(int*, const int*, const int*, int) __asm__("merge_sum.default");
+#endif
+
+int
+history_check_kernels(unsigned seed)
+{
+#ifdef HISTORY_KERNEL_CLONES
+    if( !__builtin_cpu_supports("avx2") )
+        return -1;
+    static void (*const clones[3][2])(int*, const int*, const int*, int) = {
+        { merge_min_avx2, merge_min_default },
+        { merge_max_avx2, merge_max_default },
+        { merge_sum_avx2, merge_sum_default },
+    };
+    /* An odd number of series, so no length is a multiple of the vectors */
+    enum { N_SERIES = 37 };
+    History* h = history_new(N_SERIES);
+    if( !h )
+        return -1;
+    int* arrays[3] = { h->min, h->max, h->sum };
+    for(int a=0; a<3; a++)
+        for(size_t i=0; i<(size_t)HISTORY_LEVELS*HISTORY_RING*N_SERIES; i++) {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            /* Sums stay far from overflowing */
+            arrays[a][i] = (int)(seed >> 4) - (1<<27);
+        }
+    int mismatches = 0;
+    int out[2][N_SERIES+8];
+    for(int k=1; k<HISTORY_LEVELS; k++)
+        /* Bucket 2b+1 of level k-1 wraps around the ring for the upper half */
+        for(unsigned b=0; b<HISTORY_RING; b++)
+            for(int a=0; a<3; a++)
+                for(int off=0; off<4; off++)
+                    for(int n=1; off+n<=N_SERIES; n++) {
+                        const int* x = bucket(h, arrays[a], k-1, 2*b) + off;
+                        const int* z = bucket(h, arrays[a], k-1, 2*b+1) + off;
+                        for(int c=0; c<2; c++) {
+                            memset(out[c], 0x5a, sizeof(out[c]));
+                            clones[a][c](out[c]+off, x, z, n);
+                        }
+                        mismatches += memcmp(out[0], out[1], sizeof(out[0])) != 0;
+                    }
+    history_free(h);
+    return mismatches;
+#else
+    return -1;
+#endif
+}
+
+void
+history_push(History* h, const int* sample)
+{
+    history_push_folded(h, sample, sample, sample);
+}
+
+void
+history_push_folded(History* h, const int* min, const int* max, const int* mean)
+{
+    int n = h->n_series;
+    unsigned t = h->ticks++;
+    memcpy(bucket(h, h->min, 0, t), min, n*sizeof(int));
+    memcpy(bucket(h, h->max, 0, t), max, n*sizeof(int));
+    memcpy(bucket(h, h->sum, 0, t), mean, n*sizeof(int));
+
+    /* Bucket t of level k-1 completes bucket t/2 of level k when t is odd */
+    for(int k=1; k<HISTORY_LEVELS && (t&1); k++, t>>=1)
+    {
+        merge_min(bucket(h, h->min, k, t>>1),
+                  bucket(h, h->min, k-1, t-1), bucket(h, h->min, k-1, t), n);
+        merge_max(bucket(h, h->max, k, t>>1),
+                  bucket(h, h->max, k-1, t-1), bucket(h, h->max, k-1, t), n);
+        merge_sum(bucket(h, h->sum, k, t>>1),
+                  bucket(h, h->sum, k-1, t-1), bucket(h, h->sum, k-1, t), n);
+    }
+    if( h->file ) {
+        h->file->ticks = h->ticks;
+        h->file->saved = time(NULL);
+    }
+}
+
+unsigned
+history_columns(const History* h, HistoryColumns* columns)
+{
+    int n = columns->n;
+    /* Spans about 8 minutes at 22px, and more on larger icons */
+    int per_level = 1 + n/9;
+    if(per_level > HISTORY_RING/2 - 1)
+        per_level = HISTORY_RING/2 - 1;
+
+    unsigned end = h->ticks;
+    int k = 0, shown = 0;
+    for(int c=0; c<n; c++)
+    {
+        while( k+1 < HISTORY_LEVELS && shown >= per_level && !(end & ((2u<<k)-1)) ) {
+            k++;
+            shown = 0;
+        }
+        unsigned b = (end>>k) - 1, newest = (h->ticks>>k) - 1;
+        if( !end || newest-b >= HISTORY_RING ) {
+            columns->count[c] = 0;
+            for(int s=0; s<h->n_series; s++)
+                history_min(columns, s)[c] = history_max(columns, s)[c]
+                    = history_mean(columns, s)[c] = 0;
+            continue;
+        }
+        const int *min = bucket(h, h->min, k, b), *max = bucket(h, h->max, k, b);
+        const int *sum = bucket(h, h->sum, k, b);
+        for(int s=0; s<h->n_series; s++)
+        {
+            history_min(columns, s)[c] = min[s];
+            history_max(columns, s)[c] = max[s];
+            history_mean(columns, s)[c] = sum[s] >> k;
+        }
+        columns->count[c] = 1u<<k;
+        end -= 1u<<k;
+        shown++;
+    }
+    return h->ticks - end;
+}
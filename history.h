@@ -0,0 +1,73 @@
+/* Logarithmic, multi-resolution history of samples. See history.c.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ */
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HISTORY_LEVELS 24 /* 2^24 seconds, about half a year */
+#define HISTORY_RING 32   /* enough for 15 columns per level */
+#define HISTORY_VERSION 1 /* of the file layout */
+#define HISTORY_MAX_GAP (1<<16) /* seconds, about 18h: longer gaps start afresh */
+
+/* Bulk kernels get an AVX2 clone picked at load time where supported */
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__clang__)
+#define HISTORY_KERNEL __attribute__((target_clones("avx2","default")))
+#define HISTORY_KERNEL_CLONES 1
+#else
+#define HISTORY_KERNEL
+#endif
+
+/* Header of a history file, followed by its min, max and sum arrays */
+typedef struct {
+    char magic[8];         /* "gatohist" */
+    uint32_t version;      /* HISTORY_VERSION */
+    uint32_t byte_order;   /* 0x01020304 as written */
+    uint32_t n_series, levels, ring;
+    uint32_t ticks;
+    int64_t saved;         /* time() of the last push */
+} HistoryFile;
+
+typedef struct {
+    int n_series;
+    unsigned ticks; /* samples pushed so far */
+    int *min, *max, *sum; /* [HISTORY_LEVELS][HISTORY_RING][n_series] */
+    HistoryFile* file; /* mapped, when kept in a file */
+    size_t mapped;
+    int fd;            /* holding a lock on the file */
+} History;
+
+typedef struct {
+    int n_series, n;
+    unsigned *count; /* samples summarized per column, 0 without data */
+    int *min, *max, *mean; /* [n_series][n] */
+} HistoryColumns;
+
+/* Column values of series s, one per column */
+#define history_min(c, s)  ((c)->min + (s)*(c)->n)
+#define history_max(c, s)  ((c)->max + (s)*(c)->n)
+#define history_mean(c, s) ((c)->mean + (s)*(c)->n)
+
+History* history_new(int n_series);
+/* History kept in a file, mapped and updated in place. A valid file is
+ * adopted, with the time since it was saved ('now' as from time()) pushed
+ * as empty samples. Anything else starts afresh. Returns NULL if the file
+ * can't be used, e.g. when another process holds it. */
+History* history_open(const char* path, int n_series, long long now);
+void history_free(History* h);
+HistoryColumns* history_columns_new(int n_series, int n);
+void history_push(History* h, const int* sample);
+/* One tick that summarizes several readings, keeping their extremes */
+void history_push_folded(History* h, const int* min, const int* max, const int* mean);
+/* Fill all columns, newest first. Returns the number of ticks they cover. */
+unsigned history_columns(const History* h, HistoryColumns* columns);
+/* Runs both clones of the merge kernels over the same random rings and
+ * compares them. Returns the mismatches, or -1 without an AVX2 clone. */
+int history_check_kernels(unsigned seed);
+
+#endif
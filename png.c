@@ -0,0 +1,102 @@
+/* Minimal PNG writer, for frame dumps without GTK.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Icons are tiny, so the image data goes uncompressed: zlib "stored"
+ * blocks of up to 65535 bytes, each row with filter type 0. All that is
+ * needed then is CRC-32 for the chunks and Adler-32 for the zlib stream.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "png.h"
+
+static uint32_t crc_table[256];
+
+static uint32_t
+crc32_update(uint32_t crc, const uint8_t* p, size_t n)
+{
+    if( !crc_table[1] )
+        for(uint32_t i=0; i<256; i++) {
+            uint32_t c = i;
+            for(int k=0; k<8; k++)
+                c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+            crc_table[i] = c;
+        }
+    crc = ~crc;
+    while( n-- )
+        crc = crc_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static void
+put32(uint8_t* p, uint32_t v)
+{
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static void
+chunk(FILE* f, const char* type, const uint8_t* data, uint32_t len)
+{
+    uint8_t head[8], crc[4];
+    put32(head, len);
+    memcpy(head+4, type, 4);
+    put32(crc, crc32_update(crc32_update(0, head+4, 4), data, len));
+    fwrite(head, 8, 1, f);
+    fwrite(data, len, 1, f);
+    fwrite(crc, 4, 1, f);
+}
+
+int
+png_write(const char* path, const uint32_t* pixels, int width, int height)
+{
+    size_t row = 1 + 4*(size_t)width, raw = row*height;
+    size_t blocks = (raw + 65534) / 65535;
+    uint8_t* idat = malloc(2 + raw + 5*blocks + 4);
+    FILE* f = idat ? fopen(path, "wb") : NULL;
+    if( !f ) {
+        free(idat);
+        return -1;
+    }
+
+    uint8_t ihdr[13];
+    put32(ihdr, width);
+    put32(ihdr+4, height);
+    ihdr[8] = 8;  /* bits per channel */
+    ihdr[9] = 6;  /* RGBA */
+    ihdr[10] = ihdr[11] = ihdr[12] = 0; /* deflate, adaptive filters, no interlace */
+
+    /* zlib header for deflate with a 32K window, then stored blocks */
+    uint8_t* p = idat;
+    *p++ = 0x78;
+    *p++ = 0x01;
+    uint32_t a = 1, b = 0;
+    size_t done = 0;
+    for(int y=0; y<height; y++)
+        for(size_t x=0; x<row; x++, done++)
+        {
+            if( done % 65535 == 0 ) {
+                size_t len = raw-done < 65535 ? raw-done : 65535;
+                *p++ = len == raw-done; /* last block */
+                *p++ = len; *p++ = len >> 8;
+                *p++ = ~len; *p++ = ~len >> 8;
+            }
+            uint8_t v = x ? ((const uint8_t*)(pixels + (size_t)y*width))[x-1] : 0;
+            *p++ = v;
+            a = (a + v) % 65521;
+            b = (b + a) % 65521;
+        }
+    put32(p, b << 16 | a);
+    p += 4;
+
+    fwrite("\x89PNG\r\n\x1a\n", 8, 1, f);
+    chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    chunk(f, "IDAT", idat, p - idat);
+    chunk(f, "IEND", NULL, 0);
+    free(idat);
+    return fclose(f) ? -1 : 0;
+}
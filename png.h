@@ -0,0 +1,16 @@
+/* Minimal PNG writer, for frame dumps without GTK.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ */
+#ifndef PNG_H
+#define PNG_H
+
+#include <stdint.h>
+
+/* Writes width*height RGBA pixels, R first in memory, as render() draws
+ * them. Returns -1 on failure. */
+int png_write(const char* path, const uint32_t* pixels, int width, int height);
+
+#endif
@@ -0,0 +1,287 @@
+/* Top CPU consumers, scanned incrementally from /proc.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Every process tracked keeps its /proc/PID/stat open, and each scan just
+ * pread()s it for utime+stime. /proc is only listed again when the set of
+ * processes may have changed: when the last PID handed out, from
+ * /proc/loadavg, moves on, or when a process turns out to have exited.
+ *
+ * Most processes sleep, so one that used no CPU for IDLE_SCANS scans in a
+ * row is only read on every IDLE_STRIDE-th scan, staggered by PID. Each
+ * process keeps the time of its own last read, so its share stays exact.
+ *
+ * Memory is bounded by PROCS_MAX entries. Open fds are bounded by PROCS_FDS,
+ * or a quarter of a lower RLIMIT_NOFILE, which is never raised: children
+ * such as 'top' would inherit it. Once they run out, sleepers give theirs
+ * back to processes read on every scan; the rest are opened on each read.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/resource.h>
+
+#include "cpu_usage.h"
+#include "procs.h"
+
+typedef struct {
+    int pid, fd;     /* fd is -1 past the fd budget */
+    ull time;        /* utime+stime in clock ticks, on the last read */
+    unsigned delta;  /* ticks since the read before */
+    int idle;        /* reads in a row with no ticks */
+    long long read_at; /* microseconds, when last read */
+    char comm[16];
+} Proc;
+
+/* Sorted by PID. The spare array receives each new enumeration. */
+static Proc *procs = NULL, *spare = NULL;
+static int procs_allocated = 0, fd_budget = 0;
+static int proc_fd = -1, loadavg_fd = -1;
+static long last_pid = -1;
+static unsigned scans = 0;
+
+#define IDLE_SCANS 4
+#define IDLE_STRIDE 8
+
+int procs_count = 0, procs_enumerations = 0, procs_open_fds = 0;
+
+/* /proc/PID/stat fds kept open at most */
+#define PROCS_FDS 256
+
+static void
+procs_budget(void)
+{
+    struct rlimit rl;
+    fd_budget = PROCS_FDS;
+    /* Leave most of a low limit to everything else */
+    if( getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur != RLIM_INFINITY
+     && rl.rlim_cur/4 < fd_budget )
+        fd_budget = rl.rlim_cur/4;
+}
+
+/* Reads utime+stime and comm of 'p'. Returns 0 if the process is gone. */
+static int
+proc_read(Proc* p)
+{
+    char buf[512];
+    int fd = p->fd;
+    if( fd < 0 ) {
+        snprintf(buf, sizeof(buf), "%d/stat", p->pid);
+        if( (fd = openat(proc_fd, buf, O_RDONLY|O_CLOEXEC)) < 0 )
+            return 0;
+    }
+    ssize_t len = pread(fd, buf, sizeof(buf)-1, 0);
+    if( fd != p->fd ) {
+        /* Kept for the next scans, while the budget lasts */
+        if( len > 0 && procs_open_fds < fd_budget )
+            p->fd = fd, procs_open_fds++;
+        else
+            close(fd);
+    }
+    if( len <= 0 ) {
+        /* Its PID may come back with another process, so start afresh */
+        if( p->fd >= 0 )
+            close(p->fd), procs_open_fds--;
+        p->fd = -1;
+        p->time = ~0ULL;
+        p->idle = 0;
+        return 0;
+    }
+    buf[len] = '\0';
+
+    /* "PID (comm) S ..." where comm may hold spaces and parentheses */
+    char *open = strchr(buf, '('), *close_ = strrchr(buf, ')');
+    if( !open || !close_ || close_ < open )
+        return 0;
+    size_t n = close_-open-1 < sizeof(p->comm)-1 ? close_-open-1 : sizeof(p->comm)-1;
+    memcpy(p->comm, open+1, n);
+    p->comm[n] = '\0';
+
+    /* utime and stime are fields 14 and 15, the 12th and 13th after comm */
+    char* f = close_+1;
+    for(int field=0; field<11 && f; field++)
+        f = strchr(f+1, ' ');
+    if( !f )
+        return 0;
+    char* end;
+    ull utime = strtoull(f, &end, 10), stime = strtoull(end, NULL, 10);
+    p->delta = utime+stime >= p->time ? utime+stime - p->time : 0;
+    p->time = utime+stime;
+    return 1;
+}
+
+static int
+procs_grow(int n)
+{
+    if( n <= procs_allocated )
+        return 0;
+    int size = procs_allocated ? procs_allocated : 256;
+    while( size < n )
+        size *= 2;
+    if( size > PROCS_MAX )
+        size = PROCS_MAX;
+    Proc* a = realloc(procs, size*sizeof(Proc));
+    if( a ) procs = a;
+    Proc* b = realloc(spare, size*sizeof(Proc));
+    if( b ) spare = b;
+    if( !a || !b )
+        return -1;
+    procs_allocated = size;
+    return 0;
+}
+
+static int
+proc_cmp(const void* a, const void* b)
+{
+    return ((const Proc*)a)->pid - ((const Proc*)b)->pid;
+}
+
+/* Lists /proc again, merging into the processes already tracked */
+static int
+procs_enumerate(void)
+{
+    DIR* dir = root_opendir("/proc");
+    if( !dir )
+        return -1;
+    procs_enumerations++;
+
+    /* readdir() gives PIDs in increasing order, but don't rely on it */
+    int n = 0, old = 0, sorted = 1;
+    struct dirent* de;
+    while( (de = readdir(dir)) )
+    {
+        char* end;
+        long pid = strtol(de->d_name, &end, 10);
+        if( *end || pid <= 0 )
+            continue;
+        if( n == procs_allocated && (n == PROCS_MAX || procs_grow(n+1) < 0) )
+            break;
+        if( n && pid < spare[n-1].pid )
+            sorted = 0;
+        spare[n++] = (Proc){ .pid = pid, .fd = -1 };
+    }
+    closedir(dir);
+    if( !sorted )
+        qsort(spare, n, sizeof(*spare), proc_cmp);
+
+    /* Carry over the state of survivors, close the fds of the departed */
+    for(int i=0; i<n; i++)
+    {
+        while( old < procs_count && procs[old].pid < spare[i].pid ) {
+            if( procs[old].fd >= 0 )
+                close(procs[old].fd), procs_open_fds--;
+            old++;
+        }
+        if( old < procs_count && procs[old].pid == spare[i].pid )
+            spare[i] = procs[old++];
+        else
+            spare[i].time = ~0ULL; /* new: no delta on its first read */
+    }
+    for( ; old < procs_count; old++)
+        if( procs[old].fd >= 0 )
+            close(procs[old].fd), procs_open_fds--;
+
+    Proc* t = procs;
+    procs = spare;
+    spare = t;
+    procs_count = n;
+    return 0;
+}
+
+/* Whether a PID was handed out since the last call */
+static int
+procs_forked(void)
+{
+    char buf[128];
+    ssize_t len = pread(loadavg_fd, buf, sizeof(buf)-1, 0);
+    if( len <= 0 )
+        return 1;
+    buf[len] = '\0';
+    /* "0.00 0.01 0.05 1/234 5678": the last field is the last PID */
+    char* last = strrchr(buf, ' ');
+    long pid = last ? atol(last+1) : -1;
+    int forked = pid != last_pid || pid < 0;
+    last_pid = pid;
+    return forked;
+}
+
+int
+procs_scan(ProcsTop* top, int n, int scale)
+{
+    if( proc_fd < 0 ) {
+        if( (proc_fd = root_open("/proc")) < 0 )
+            return -1;
+        loadavg_fd = root_open("/proc/loadavg");
+        procs_budget();
+    }
+    if( (loadavg_fd < 0 || procs_forked()) && procs_enumerate() < 0 )
+        return -1;
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    long long now = t.tv_sec*1000000LL + t.tv_nsec/1000;
+    long long hz = sysconf(_SC_CLK_TCK);
+    scans++;
+
+    int found = 0, gone = 0;
+    for(Proc* p = procs; p < procs+procs_count; p++)
+    {
+        if( p->idle >= IDLE_SCANS && (p->pid + scans) % IDLE_STRIDE )
+            continue;
+        long long elapsed = now - p->read_at;
+        if( !proc_read(p) ) {
+            gone = 1;
+            continue;
+        }
+        p->read_at = now;
+        p->idle = p->delta ? 0 : p->idle + (p->idle < IDLE_SCANS);
+        /* Once out of fds, sleepers hand theirs to processes read on every scan */
+        if( p->idle >= IDLE_SCANS && p->fd >= 0 && procs_open_fds >= fd_budget )
+            close(p->fd), p->fd = -1, procs_open_fds--;
+        if( !p->delta || elapsed <= 0 )
+            continue;
+        /* Keep the busiest 'n', by insertion into the few there are */
+        int usage = (long long)p->delta*scale*1000000/(hz*elapsed);
+        if( !usage )
+            continue;
+        int i = found < n ? found++ : n;
+        for( ; i>0 && top[i-1].usage < usage; i--)
+            if( i < n )
+                top[i] = top[i-1];
+        if( i < n ) {
+            top[i].pid = p->pid;
+            top[i].usage = usage;
+            memcpy(top[i].comm, p->comm, sizeof(top[i].comm));
+        }
+    }
+    /* Forget the departed on the next scan */
+    if( gone )
+        last_pid = -1;
+    return found;
+}
+
+void
+procs_close(void)
+{
+    for(Proc* p = procs; p < procs+procs_count; p++)
+        if( p->fd >= 0 )
+            close(p->fd);
+    free(procs);
+    free(spare);
+    procs = spare = NULL;
+    procs_allocated = procs_count = procs_open_fds = 0;
+    if( proc_fd >= 0 )
+        close(proc_fd);
+    if( loadavg_fd >= 0 )
+        close(loadavg_fd);
+    proc_fd = loadavg_fd = -1;
+    last_pid = -1;
+    scans = 0;
+}
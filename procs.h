@@ -0,0 +1,30 @@
+/* Top CPU consumers, scanned incrementally from /proc, without GTK.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ */
+#ifndef PROCS_H
+#define PROCS_H
+
+/* Processes tracked at most, past that the rest are not seen */
+#define PROCS_MAX 16384
+/* Consumers worth listing in the tooltip */
+#define PROCS_TOP 5
+
+typedef struct {
+    int pid;
+    int usage;     /* share of one CPU, 0~scale, or more if multithreaded */
+    char comm[16]; /* as in /proc/PID/comm */
+} ProcsTop;
+
+/* Processes tracked, /proc enumerations and fds kept open so far */
+extern int procs_count, procs_enumerations, procs_open_fds;
+
+/* Fills 'top' with up to 'n' of the busiest processes since the last call,
+ * busiest first. Returns how many, or -1 if /proc can't be read. Uses the
+ * root given to sampler_init(). */
+int procs_scan(ProcsTop* top, int n, int scale);
+void procs_close(void);
+
+#endif
@@ -0,0 +1,105 @@
+/* Pressure stall information collector.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * /proc/pressure/{cpu,io,memory} (Linux 4.20+) have two lines like:
+ *   some avg10=0.00 avg60=0.00 avg300=0.00 total=123456
+ *   full avg10=0.00 avg60=0.00 avg300=0.00 total=23456
+ * The kernel averages lag behind, so stalls come from the cumulative totals
+ * instead, in microseconds, divided by the time elapsed between reads.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cpu_usage.h"
+
+static const char* psi_files[PSI_RESOURCES] = {
+    "/proc/pressure/cpu", "/proc/pressure/io", "/proc/pressure/memory"
+};
+
+static struct {
+    int fd;
+    unsigned long long some, full; /* totals on the last read */
+} psi[PSI_RESOURCES];
+static int psi_state = 0; /* 0 unopened, 1 available, -1 not there */
+static long long psi_last = 0;
+
+/* Total of the line starting with 'kind', or 0 */
+static unsigned long long
+psi_total(const char* buf, const char* kind)
+{
+    const char* line = buf;
+    size_t len = strlen(kind);
+    while( line && strncmp(line, kind, len) )
+        if( (line = strchr(line, '\n')) )
+            line++;
+    const char* total = line ? strstr(line, "total=") : NULL;
+    return total ? strtoull(total+6, NULL, 10) : 0;
+}
+
+static int
+psi_open(void)
+{
+    int found = 0;
+    for(int r=0; r<PSI_RESOURCES; r++)
+        found += (psi[r].fd = root_open(psi_files[r])) >= 0;
+    return found ? 1 : -1;
+}
+
+int
+psi_read(PSI_Stall* stall, int scale)
+{
+    memset(stall, 0, PSI_RESOURCES*sizeof(*stall));
+    if( !psi_state )
+        psi_state = psi_open();
+    if( psi_state < 0 )
+        return 0;
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    long long now = t.tv_sec*1000000LL + t.tv_nsec/1000, elapsed = now - psi_last;
+    int available = 0;
+    for(int r=0; r<PSI_RESOURCES; r++)
+    {
+        char buf[256];
+        ssize_t len = psi[r].fd >= 0 ? pread(psi[r].fd, buf, sizeof(buf)-1, 0) : -1;
+        if( len <= 0 ) {
+            /* Also with psi=0 on the command line: EOPNOTSUPP */
+            if( psi[r].fd >= 0 )
+                close(psi[r].fd);
+            psi[r].fd = -1;
+            continue;
+        }
+        buf[len] = '\0';
+        unsigned long long some = psi_total(buf, "some "), full = psi_total(buf, "full ");
+        if( psi_last && elapsed > 0 ) {
+            long long s = some >= psi[r].some ? (some - psi[r].some)*scale/elapsed : 0;
+            long long f = full >= psi[r].full ? (full - psi[r].full)*scale/elapsed : 0;
+            stall[r].some = s > scale ? scale : s;
+            stall[r].full = f > scale ? scale : f;
+        }
+        psi[r].some = some;
+        psi[r].full = full;
+        available++;
+    }
+    psi_last = now;
+    if( !available )
+        psi_state = -1;
+    return available;
+}
+
+void
+psi_close(void)
+{
+    if( psi_state > 0 )
+        for(int r=0; r<PSI_RESOURCES; r++)
+            if( psi[r].fd >= 0 )
+                close(psi[r].fd);
+    psi_state = 0;
+    psi_last = 0;
+}
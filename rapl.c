@@ -0,0 +1,153 @@
+/* RAPL energy counters collector, for power draw.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * The powercap class has one zone per package, /sys/class/powercap/
+ * intel-rapl:N named "package-N", with subzones intel-rapl:N:M for "core",
+ * "uncore" or "dram". Each has energy_uj, a counter of microjoules that
+ * wraps around at max_energy_range_uj. Watts come from its delta over the
+ * time elapsed. The long-term limit, constraint_0_power_limit_uw, gives
+ * the package power its full scale, or else the highest power seen does.
+ *
+ * energy_uj is only readable by root on recent kernels, in which case this
+ * just finds nothing to read.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "cpu_usage.h"
+
+#define MAX_DOMAINS 16
+
+typedef struct {
+    int fd;
+    int dram;      /* else a package */
+    ull range;     /* where the counter wraps, in uJ */
+    ull last;      /* counter on the last read */
+} RaplDomain;
+
+static RaplDomain domains[MAX_DOMAINS];
+static int n_domains = 0;
+static int rapl_state = 0; /* 0 unopened, 1 available, -1 not there */
+static long long rapl_last = 0;
+static long long limit_mw = 0, peak_mw = 0;
+
+/* Reads a number from 'file' of the zone, or 0 */
+static ull
+zone_value(const char* zone, const char* file)
+{
+    char path[PATH_MAX], buf[32];
+    snprintf(path, sizeof(path), "/sys/class/powercap/%s/%s", zone, file);
+    int fd = root_open(path);
+    ssize_t len = fd >= 0 ? pread(fd, buf, sizeof(buf)-1, 0) : -1;
+    if( fd >= 0 )
+        close(fd);
+    if( len <= 0 )
+        return 0;
+    buf[len] = '\0';
+    return strtoull(buf, NULL, 10);
+}
+
+static int
+rapl_open(void)
+{
+    DIR* dir = root_opendir("/sys/class/powercap");
+    if( !dir )
+        return -1;
+    struct dirent* de;
+    while( (de = readdir(dir)) && n_domains < MAX_DOMAINS )
+    {
+        /* "intel-rapl" itself is the control type, zones have a ':' */
+        if( strncmp(de->d_name, "intel-rapl:", 11) )
+            continue;
+        char path[PATH_MAX], name[32];
+        snprintf(path, sizeof(path), "/sys/class/powercap/%s/name", de->d_name);
+        int fd = root_open(path);
+        ssize_t len = fd >= 0 ? pread(fd, name, sizeof(name)-1, 0) : -1;
+        if( fd >= 0 )
+            close(fd);
+        if( len <= 0 )
+            continue;
+        name[len] = '\0';
+        int dram = !strncmp(name, "dram", 4);
+        if( !dram && strncmp(name, "package", 7) )
+            continue; /* core and uncore are part of the package, psys is more */
+
+        RaplDomain* d = &domains[n_domains];
+        snprintf(path, sizeof(path), "/sys/class/powercap/%s/energy_uj", de->d_name);
+        if( (d->fd = root_open(path)) < 0 )
+            continue;
+        d->dram = dram;
+        d->range = zone_value(de->d_name, "max_energy_range_uj");
+        if( !dram )
+            limit_mw += zone_value(de->d_name, "constraint_0_power_limit_uw") / 1000;
+        n_domains++;
+    }
+    closedir(dir);
+    return n_domains ? 1 : -1;
+}
+
+int
+rapl_read(RAPL_Power* power, int scale)
+{
+    memset(power, 0, sizeof(*power));
+    if( !rapl_state )
+        rapl_state = rapl_open();
+    if( rapl_state < 0 )
+        return 0;
+
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    long long now = t.tv_sec*1000000LL + t.tv_nsec/1000, elapsed = now - rapl_last;
+    long long package = 0, dram = 0;
+    int read = 0;
+    for(RaplDomain* d = domains; d < domains+n_domains; d++)
+    {
+        char buf[32];
+        ssize_t len = pread(d->fd, buf, sizeof(buf)-1, 0);
+        if( len <= 0 )
+            continue;
+        buf[len] = '\0';
+        ull energy = strtoull(buf, NULL, 10);
+        /* Counters wrap around at their range, at most once between reads.
+         * Without a known range, going back is a reset: start over from it. */
+        ull delta = energy >= d->last ? energy - d->last
+                  : d->range ? energy + d->range - d->last : 0;
+        if( rapl_last && elapsed > 0 ) {
+            /* uJ per us is W, times 1000 for mW */
+            long long mw = delta*1000/elapsed;
+            *(d->dram ? &dram : &package) += mw;
+        }
+        d->last = energy;
+        read++;
+    }
+    if( !read )
+        return 0;
+    if( rapl_last && elapsed > 0 ) {
+        power->package = package;
+        power->dram = dram;
+        if( package > peak_mw )
+            peak_mw = package;
+        long long full = limit_mw ? limit_mw : peak_mw;
+        power->share = full ? (package < full ? package : full)*scale/full : 0;
+    }
+    rapl_last = now;
+    return read;
+}
+
+void
+rapl_close(void)
+{
+    for(RaplDomain* d = domains; d < domains+n_domains; d++)
+        close(d->fd);
+    n_domains = 0;
+    rapl_state = 0;
+    rapl_last = limit_mw = peak_mw = 0;
+}
@@ -0,0 +1,555 @@
+/* Software rendering of the icon from history, without GTK.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Columns are drawn newest on the left, from the bulk column sizes of
+ * history_columns(), and only those that changed since the last render()
+ * are repainted. The termometer is rasterized over the first columns.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "render.h"
+
+#define MIN(a,b) ((a)<(b)?(a):(b))
+#define MAX(a,b) ((a)>(b)?(a):(b))
+#define ABS(a) ((a)<0?-(a):(a))
+
+int
+render_sample(int* values, const Sample* sample, int n_cores)
+{
+    values[H_USAGE] = sample->cpu.usage;
+    /* A cgroup has no iowait of its own, but throttling is as much of a wait */
+    values[H_IOWAIT] = sample->cgroup ? sample->throttled : sample->cpu.iowait;
+    values[H_FREQ] = sample->freq_avg;
+    values[H_FREQ_MAX] = sample->freq_max;
+    values[H_TEMP] = sample->temp;
+    values[H_POWER] = sample->power.share;
+    /* Those are the host's, which a cgroup's usage does not stack on */
+    values[H_IRQ] = sample->cgroup ? 0 : sample->cpu.irq;
+    values[H_STEAL] = sample->cgroup ? 0 : sample->cpu.steal;
+    for(int r=0; r<PSI_RESOURCES; r++) {
+        values[H_PSI_SOME(r)] = sample->psi[r].some;
+        values[H_PSI_FULL(r)] = sample->psi[r].full;
+    }
+    /* Cores that came online after startup are left out of the graph */
+    int busiest = 0;
+    for(int i=0; i<n_cores; i++) {
+        values[H_CORES+i] = i < sample->n_cores ? sample->core[i].usage : 0;
+        if(values[H_CORES+i] > values[H_CORES+busiest])
+            busiest = i;
+    }
+    return busiest;
+}
+
+/* Bytes per second as 0~SCALE, from 2^10 to 2^30 in 1/8 octave steps */
+static int
+rate_scaled(ull rate)
+{
+    if( rate < 1024 )
+        return 0;
+    int octave = 63 - __builtin_clzll(rate);
+    int eighths = octave*8 + (int)((rate << (63-octave)) >> 60 & 7);
+    int v = (eighths - 10*8) * SCALE / (20*8);
+    return v > SCALE ? SCALE : v;
+}
+
+void
+render_extra(int* values, int extra, const Sample* s)
+{
+    memset(values, 0, H_CORES*sizeof(*values));
+    switch( extra ) {
+        case RENDER_MEMORY:
+            values[H_USAGE] = values[H_FREQ] = s->mem.used;
+            values[H_IOWAIT] = s->mem.swap;
+            break;
+        case RENDER_DISK:
+            values[H_USAGE] = rate_scaled(s->disk.read + s->disk.written);
+            values[H_IOWAIT] = values[H_FREQ] = s->disk.busy;
+            break;
+        case RENDER_NETWORK:
+            values[H_USAGE] = values[H_FREQ] = rate_scaled(s->net.rx);
+            values[H_IOWAIT] = rate_scaled(s->net.tx);
+            break;
+    }
+}
+
+/* As KB/s, MB/s or GB/s with one decimal */
+static const char*
+format_rate(char* buf, ull rate)
+{
+    static const char* units[] = { "KB/s", "MB/s", "GB/s" };
+    int u = 0;
+    rate = rate*10/1024;
+    for( ; u < 2 && rate >= 10240; u++)
+        rate /= 1024;
+    sprintf(buf, "%llu.%llu %s", rate/10, rate%10, units[u]);
+    return buf;
+}
+
+int
+render_extra_tooltip(char* buf, size_t size, int extra, const Sample* s, unsigned span)
+{
+    char a[32], b[32];
+    int len = 0;
+    switch( extra ) {
+        case RENDER_MEMORY:
+            len = snprintf(buf, size, "Memory %d%% used, %llu MB available\n"
+                           "Swap %d%% used, %llu MB\n"
+                           , s->mem.used*100/SCALE, s->mem.available/1024
+                           , s->mem.swap*100/SCALE, s->mem.swap_used/1024);
+            break;
+        case RENDER_DISK:
+            len = snprintf(buf, size, "Disks %d%% busy\nRead %s, written %s\n"
+                           , s->disk.busy*100/SCALE
+                           , format_rate(a, s->disk.read), format_rate(b, s->disk.written));
+            break;
+        case RENDER_NETWORK:
+            len = snprintf(buf, size, "Network\nReceived %s, sent %s\n"
+                           , format_rate(a, s->net.rx), format_rate(b, s->net.tx));
+            break;
+    }
+    if( len < 0 || len >= size )
+        return len;
+    return len + snprintf(buf+len, size-len, "Graph spans %u:%02u:%02u"
+                          , span/3600, span/60%60, span%60);
+}
+
+/* black, white, blue, green, red, blue, red, orange, magenta */
+const RenderColor render_default_colors[COLORS] = {
+    { 0, 0, 0 }, { 0xffff, 0xffff, 0xffff }, { 0, 0, 0xffff },
+    { 0, 0xffff, 0 }, { 0xffff, 0, 0 }, { 0, 0, 0xffff }, { 0xffff, 0, 0 },
+    { 0xffff, 0xa5a5, 0 }, { 0xffff, 0, 0xffff },
+};
+
+static uint32_t
+rgba_pixel(RenderColor color, uint8_t alpha)
+{
+    uint8_t rgba[4] = { color.red >> 8, color.green >> 8, color.blue >> 8, alpha };
+    uint32_t pixel;
+    memcpy(&pixel, rgba, sizeof(pixel));
+    return pixel;
+}
+
+/* i/99 of the way from 'a' to 'b' */
+static RenderColor
+gradient(RenderColor a, RenderColor b, int i)
+{
+    RenderColor c = {
+        .red   = (a.red   * (99 - i) + b.red   * i) / 99,
+        .green = (a.green * (99 - i) + b.green * i) / 99,
+        .blue  = (a.blue  * (99 - i) + b.blue  * i) / 99,
+    };
+    return c;
+}
+
+void
+palette_build(Palette* palette, const RenderColor* colors, int transparent)
+{
+    RenderColor bg = colors[COLOR_BG], freq_max = colors[COLOR_FREQ_MAX];
+    for(int i=0; i<100; i++)
+    {
+        RenderColor freq = gradient(colors[COLOR_FREQ_MIN], freq_max, i);
+        palette->freq[i] = rgba_pixel(freq, 255);
+        palette->temp[i] = rgba_pixel(gradient(colors[COLOR_TEMP_MIN], colors[COLOR_TEMP_MAX], i), 255);
+        if( transparent ) {
+            palette->peak[i] = rgba_pixel(freq, 128);
+            palette->heat[i] = rgba_pixel(freq_max, i * 255 / 99);
+        } else {
+            RenderColor peak = {
+                .red   = (freq.red   + bg.red)   / 2,
+                .green = (freq.green + bg.green) / 2,
+                .blue  = (freq.blue  + bg.blue)  / 2,
+            };
+            palette->peak[i] = rgba_pixel(peak, 255);
+            palette->heat[i] = rgba_pixel(gradient(bg, freq_max, i), 255);
+        }
+    }
+    palette->fg = rgba_pixel(colors[COLOR_FG], 255);
+    palette->iow = rgba_pixel(colors[COLOR_IOWAIT], 255);
+    palette->irq = rgba_pixel(colors[COLOR_IRQ], 255);
+    palette->steal = rgba_pixel(colors[COLOR_STEAL], 255);
+    /* A transparent background is just a fully transparent bg pixel */
+    palette->bg = rgba_pixel(bg, transparent ? 0 : 255);
+}
+
+static const RenderPoint Termometer[] = {{2,16},{2,2},{3,1},{4,1},{5,2},{5,16},{6,17},
+    {6,19},{5,20},{2,20},{1,19},{1,17},{2,16}};
+#define Termometer_points (sizeof(Termometer)/sizeof(*Termometer))
+#define Termometer_tube_size 6 /* first points are the 'tube' */
+#define Termometer_scale 22
+enum { C_IOWAIT, C_USAGE, C_PEAK, C_SHADE, C_IRQ, C_STEAL, C_ROWS };
+
+Renderer*
+renderer_new(int n_cores)
+{
+    Renderer* r = calloc(1, sizeof(*r));
+    if( r )
+        r->n_cores = n_cores;
+    return r;
+}
+
+int
+renderer_resize(Renderer* r, int size, uint32_t* pixels)
+{
+    size_t rows = MAX(C_ROWS, size);
+    free(r->columns);
+    free(r->column_sizes);
+    free(r->painted);
+    free(r->group_usage);
+    r->columns = history_columns_new(H_CORES+r->n_cores, size);
+    r->column_sizes = malloc(rows*size*sizeof(*r->column_sizes));
+    r->painted = malloc(rows*size*sizeof(*r->painted));
+    r->group_usage = malloc(size*sizeof(*r->group_usage));
+    r->size = size;
+    r->pixels = pixels;
+    r->stale = 1;
+
+    r->termometer_width = 0;
+    for(int i=0; i<Termometer_points; i++)
+    {
+        r->termometer[i].x = Termometer[i].x*size/Termometer_scale;
+        r->termometer_width = MAX(r->termometer_width, r->termometer[i].x+1);
+        r->termometer[i].y = Termometer[i].y*size/Termometer_scale;
+        if(i<Termometer_tube_size)
+            r->tube[i] = r->termometer[i];
+    }
+    return r->columns && r->column_sizes && r->painted && r->group_usage ? 0 : -1;
+}
+
+void
+renderer_free(Renderer* r)
+{
+    if( !r )
+        return;
+    free(r->columns);
+    free(r->column_sizes);
+    free(r->painted);
+    free(r->group_usage);
+    free(r);
+}
+
+/* Vertical span [top,bottom) of column x */
+static inline void
+draw_column(const Renderer* r, uint32_t pixel, int x, int top, int bottom)
+{
+    int width = r->size;
+    if(top < 0) top = 0;
+    if(bottom > width) bottom = width;
+    for(uint32_t *p = r->pixels+top*width+x; top < bottom; top++, p += width)
+        *p = pixel;
+}
+
+static void
+draw_lines(const Renderer* r, uint32_t pixel, const RenderPoint* points, int n)
+{
+    int width = r->size;
+    for(int i=1; i<n; i++)
+    {
+        /* Bresenham, both ends included */
+        int x = points[i-1].x, y = points[i-1].y;
+        int dx = ABS(points[i].x-x), sx = x<points[i].x ? 1 : -1;
+        int dy = -ABS(points[i].y-y), sy = y<points[i].y ? 1 : -1;
+        for(int err = dx+dy;;)
+        {
+            if(x>=0 && x<width && y>=0 && y<width)
+                r->pixels[y*width+x] = pixel;
+            if(x==points[i].x && y==points[i].y)
+                break;
+            int e2 = 2*err;
+            if(e2 >= dy) { err += dy; x += sx; }
+            if(e2 <= dx) { err += dx; y += sy; }
+        }
+    }
+}
+
+static inline int
+ceil_int(float v)
+{
+    int i = (int)v;
+    return i < v ? i+1 : i;
+}
+
+/* Even-odd scanline fill, sampling at pixel centers like X does */
+static void
+fill_polygon(const Renderer* r, uint32_t pixel, const RenderPoint* points, int n)
+{
+    int width = r->size;
+    assert(n <= 16);
+    for(int y=0; y<width; y++)
+    {
+        float xs[16], yc = y+.5f;
+        int nx = 0;
+        for(int i=0, j=n-1; i<n; j=i++)
+        {
+            const RenderPoint *a = &points[j], *b = &points[i];
+            if( (a->y <= y) != (b->y <= y) )
+            {
+                float x = a->x + (yc-a->y)*(b->x-a->x)/(b->y-a->y);
+                int k = nx++;
+                for( ; k>0 && xs[k-1]>x; k--)
+                    xs[k] = xs[k-1];
+                xs[k] = x;
+            }
+        }
+        for(int k=0; k+1<nx; k+=2)
+        {
+            int x0 = MAX(0, ceil_int(xs[k]-.5f));
+            int x1 = MIN(width, ceil_int(xs[k+1]-.5f));
+            for(uint32_t *p = r->pixels+y*width+x0; x0 < x1; x0++)
+                *p++ = pixel;
+        }
+    }
+}
+
+/* Clamped, as history may come from a file */
+static HISTORY_KERNEL void
+scale_series(int16_t* restrict out, const int* restrict values, int n, int size)
+{
+    for(int i=0; i<n; i++) {
+        int v = values[i] < 0 ? 0 : values[i] > SCALE ? SCALE : values[i];
+        out[i] = v*size/SCALE;
+    }
+}
+
+static HISTORY_KERNEL void
+max_series(int* restrict out, const int* restrict values, int n)
+{
+    for(int i=0; i<n; i++)
+        out[i] = values[i] > out[i] ? values[i] : out[i];
+}
+
+#ifdef HISTORY_KERNEL_CLONES
+void scale_series_avx2(int16_t*, const int*, int, int) __asm__("scale_series.avx2");
+void scale_series_default(int16_t*, const int*, int, int) __asm__("scale_series.default");
+void max_series_avx2(int*, const int*, int) __asm__("max_series.avx2");
+void max_series_default(int*, const int*, int) __asm__("max_series.default");
+#endif
+
+int
+render_check_kernels(unsigned seed)
+{
+#ifdef HISTORY_KERNEL_CLONES
+    if( !__builtin_cpu_supports("avx2") )
+        return -1;
+    /* Odd widths, with values beyond 0~SCALE to be clamped */
+    enum { N = 257 };
+    int values[N], max[2][N+8];
+    int16_t scaled[2][N+8];
+    for(int i=0; i<N; i++) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        values[i] = (int)(seed % (3*SCALE)) - SCALE;
+    }
+    static const int sizes[] = { 16, 22, 99, 256 };
+    int mismatches = 0;
+    for(int off=0; off<4; off++)
+        for(int n=1; off+n<=N; n++) {
+            for(int s=0; s<sizeof(sizes)/sizeof(*sizes); s++) {
+                memset(scaled, 0x5a, sizeof(scaled));
+                scale_series_avx2(scaled[0]+off, values+off, n, sizes[s]);
+                scale_series_default(scaled[1]+off, values+off, n, sizes[s]);
+                mismatches += memcmp(scaled[0], scaled[1], sizeof(scaled[0])) != 0;
+            }
+            for(int c=0; c<2; c++)
+                for(int i=0; i<N+8; i++)
+                    max[c][i] = (i*7919) % (2*SCALE) - SCALE/2;
+            max_series_avx2(max[0]+off, values+off, n);
+            max_series_default(max[1]+off, values+off, n);
+            mismatches += memcmp(max[0], max[1], sizeof(max[0])) != 0;
+        }
+    return mismatches;
+#else
+    return -1;
+#endif
+}
+
+static void
+compute_column_sizes(Renderer* r, const RenderOptions* options)
+{
+    int width = r->size, n_cores = r->n_cores;
+    const HistoryColumns* columns = r->columns;
+    r->heatmap = options->heatmap && n_cores;
+    if( r->heatmap )
+    {
+        /* Group cores when there are more than pixels, showing the busiest */
+        r->column_rows = MIN(n_cores, width);
+        for(int g=0; g<r->column_rows; g++)
+        {
+            int first = g*n_cores/r->column_rows, last = (g+1)*n_cores/r->column_rows;
+            memcpy(r->group_usage, history_mean(columns, H_CORES+first), width*sizeof(int));
+            for(int core=first+1; core<last; core++)
+                max_series(r->group_usage, history_mean(columns, H_CORES+core), width);
+            scale_series(r->column_sizes+g*width, r->group_usage, width, 99);
+        }
+        return;
+    }
+    r->column_rows = C_ROWS;
+    scale_series(r->column_sizes+C_IOWAIT*width, history_mean(columns, options->strip), width, width);
+    scale_series(r->column_sizes+C_USAGE*width, history_mean(columns, H_USAGE), width, width);
+    if(options->peaks)
+        scale_series(r->column_sizes+C_PEAK*width, history_max(columns, H_USAGE), width, width);
+    else
+        memset(r->column_sizes+C_PEAK*width, 0, width*sizeof(*r->column_sizes));
+    scale_series(r->column_sizes+C_SHADE*width,
+                 history_mean(columns, options->shade), width, 99);
+    scale_series(r->column_sizes+C_IRQ*width, history_mean(columns, H_IRQ), width, width);
+    scale_series(r->column_sizes+C_STEAL*width, history_mean(columns, H_STEAL), width, width);
+    /* Or shade by temperature, clamped to 0~99, and paint with palette->temp[shade] */
+}
+
+static inline int
+column_changed(const Renderer* r, int i)
+{
+    int width = r->size;
+    for(int row=0, c=width-1-i; row<r->column_rows; row++, c+=width)
+        if(r->column_sizes[c] != r->painted[c])
+            return 1;
+    return 0;
+}
+
+static void
+paint_column(Renderer* r, const Palette* palette, int i)
+{
+    int width = r->size;
+    const int16_t *c = r->column_sizes + width-1-i;
+    for(int row=0; row<r->column_rows; row++)
+        r->painted[row*width+width-1-i] = c[row*width];
+
+    if( r->heatmap )
+    {
+        int rows = r->column_rows;
+        for(int g=0; g<rows; g++)
+            draw_column(r, palette->heat[c[g*width]], i, g*width/rows, (g+1)*width/rows);
+        return;
+    }
+
+    /* Bottom blue strip for i/o waiting cycles, or stalls: */
+    int bottom = width-c[C_IOWAIT*width], usage = c[C_USAGE*width], shade = c[C_SHADE*width];
+    /* Interrupts at the foot of the bar, time stolen by the hypervisor on
+     * top of it, and the peak envelope above both */
+    int irq = MIN(c[C_IRQ*width], usage), stolen = usage + c[C_STEAL*width];
+    int peak = MAX(c[C_PEAK*width], stolen);
+    draw_column(r, palette->bg, i, 0, bottom-peak);
+    draw_column(r, palette->peak[shade], i, bottom-peak, bottom-stolen);
+    draw_column(r, palette->steal, i, bottom-stolen, bottom-usage);
+    draw_column(r, palette->freq[shade], i, bottom-usage, bottom-irq);
+    draw_column(r, palette->irq, i, bottom-irq, bottom);
+    draw_column(r, palette->iow, i, bottom, width);
+}
+
+int
+render(Renderer* r, const History* h, const Palette* palette,
+       const RenderOptions* options, int temp, int blink)
+{
+    int all = r->stale;
+    r->span = history_columns(h, r->columns);
+    compute_column_sizes(r, options);
+
+    int T = temp;
+    if( !T ) /* Hide if 0, meaning it could not be read */
+        T = -1;
+    else if( T>=RENDER_HOT_TEMP && blink ) /* Blink when hot! */
+        T = -1;
+    else {
+        /* scale temp from 5~105 degrees Celsius to 0~100*/
+        T = (T-5)*100/100;
+        if(T<0) T=0;
+        if(T>99) T=99;
+    }
+
+    /* Any change below the termometer means repainting it, and all of it */
+    int termo = all || T != r->painted_termo;
+    for(int i=0; !termo && i<r->termometer_width; i++)
+        termo = column_changed(r, i);
+
+    int changed = termo;
+    for(int i=0; i<r->size; i++)
+    {
+        if( all || (termo && i<r->termometer_width) || column_changed(r, i) ) {
+            paint_column(r, palette, i);
+            changed = 1;
+        }
+    }
+
+    if( termo && T>=0 )
+    {
+        fill_polygon(r, palette->temp[T], r->termometer, Termometer_points);
+        if( T<99 )
+        {
+            r->tube[0].y = (T*r->termometer[1].y+(99-T)*r->termometer[0].y)/99;
+            r->tube[Termometer_tube_size-1].y = r->tube[0].y;
+            fill_polygon(r, palette->bg, r->tube, Termometer_tube_size);
+        }
+        draw_lines(r, palette->fg, r->termometer, Termometer_points);
+    }
+    r->painted_termo = T;
+    r->stale = 0;
+    return changed;
+}
+
+int
+render_tooltip(char* buf, size_t size, const Sample* s,
+               const ProcsTop* top, int n_top, unsigned span)
+{
+    int busiest = 0;
+    for(int i=1; i<s->n_cores; i++)
+        if(s->core[i].usage > s->core[busiest].usage)
+            busiest = i;
+    /* Stalls as some/full, where the kernel has PSI */
+    char psi[64] = "";
+    if( s->psi_available )
+        snprintf(psi, sizeof(psi), "Pressure: cpu %d%%, io %d/%d%%, mem %d/%d%%\n"
+                 , s->psi[PSI_CPU].some*100/SCALE
+                 , s->psi[PSI_IO].some*100/SCALE, s->psi[PSI_IO].full*100/SCALE
+                 , s->psi[PSI_MEMORY].some*100/SCALE, s->psi[PSI_MEMORY].full*100/SCALE);
+    /* Usage is then that of the cgroup, out of its quota */
+    char scope[320] = "";
+    if( s->cgroup )
+        snprintf(scope, sizeof(scope), "Cgroup %s, %d%% throttled\n"
+                 , s->cgroup, s->throttled*100/SCALE);
+    /* Where busy time went, and what a hypervisor took; not for a cgroup */
+    char breakdown[96] = "";
+    if( !s->cgroup )
+        snprintf(breakdown, sizeof(breakdown), "Time: %d%% user/system, %d%% irq, %d%% steal, %d%% guest\n"
+                 , (s->cpu.usage-s->cpu.irq)*100/SCALE, s->cpu.irq*100/SCALE
+                 , s->cpu.steal*100/SCALE, s->cpu.guest*100/SCALE);
+    /* Power, where RAPL counters can be read */
+    char power[64] = "";
+    if( s->power.package )
+        snprintf(power, sizeof(power), "Power: %d.%d W package, %d.%d W dram\n"
+                 , s->power.package/1000, s->power.package%1000/100
+                 , s->power.dram/1000, s->power.dram%1000/100);
+    /* Top consumers, as a share of one CPU like top shows them */
+    char procs[PROCS_TOP*32] = "";
+    for(int i=0, len=0; i<n_top && i<PROCS_TOP; i++)
+        len += snprintf(procs+len, sizeof(procs)-len, "%4d%% %s (%d)\n"
+                        , top[i].usage*100/SCALE, top[i].comm, top[i].pid);
+    return snprintf(buf, size,
+                    "%s"
+                    "CPU %d%% busy @ %d MHz (%d~%d), %d%%wa\n"
+                    "%s"
+                    "%s"
+                    "Temperature: %d C (%s)\n"
+                    "%s"
+                    "Busiest core: #%d at %d%%\n"
+                    "%s"
+                    "Graph spans %u:%02u:%02u\n"
+                    "(click for 'top')"
+                    , scope
+                    , s->cpu.usage*100/SCALE, s->freq.avg/1000
+                    , s->freq.min/1000, s->freq.max/1000
+                    , s->cpu.iowait*100/SCALE
+                    , breakdown
+                    , psi
+                    , s->temp, *s->temp_sensor ? s->temp_sensor : "no sensor"
+                    , power
+                    , busiest, s->n_cores ? s->core[busiest].usage*100/SCALE : 0
+                    , procs
+                    , span/3600, span/60%60, span%60);
+}
@@ -0,0 +1,112 @@
+/* Software rendering of the icon from history, without GTK.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ */
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu_usage.h"
+#include "history.h"
+#include "procs.h"
+
+/* Full scale of every series in history */
+#define SCALE 100
+/* Celsius from which the termometer blinks */
+#define RENDER_HOT_TEMP 85
+
+/* Series kept in history, one per core from H_CORES on */
+enum { H_USAGE, H_IOWAIT, H_FREQ, H_FREQ_MAX, H_TEMP, H_POWER, H_IRQ, H_STEAL,
+       H_PSI, H_CORES = H_PSI + 2*PSI_RESOURCES };
+/* Some and full stalls on one of the PSI_* resources */
+#define H_PSI_SOME(resource) (H_PSI + 2*(resource))
+#define H_PSI_FULL(resource) (H_PSI + 2*(resource) + 1)
+
+/* Fills the H_* series of 'values' from a sample of 0~SCALE values.
+ * Cores past n_cores are left out. Returns the busiest core. */
+int render_sample(int* values, const Sample* sample, int n_cores);
+
+/* Extra icons, drawn from a history of H_CORES series and a renderer of no
+ * cores: the bar is H_USAGE, the bottom strip H_IOWAIT and the shade H_FREQ.
+ *   memory:  used, swap used, shaded by used
+ *   disk:    read + written, time busy, shaded by time busy
+ *   network: received, sent, shaded by received
+ * Throughput is on a log scale, from 1 KiB/s to 1 GiB/s. */
+enum { RENDER_MEMORY, RENDER_DISK, RENDER_NETWORK, RENDER_EXTRAS };
+
+void render_extra(int* values, int extra, const Sample* sample);
+int render_extra_tooltip(char* buf, size_t size, int extra, const Sample* sample, unsigned span);
+
+/* Colors the palette is built from, in the order of the preferences */
+enum { COLOR_FG, COLOR_BG, COLOR_IOWAIT, COLOR_FREQ_MIN, COLOR_FREQ_MAX,
+       COLOR_TEMP_MIN, COLOR_TEMP_MAX, COLOR_IRQ, COLOR_STEAL, COLORS };
+
+typedef struct {
+    uint16_t red, green, blue;
+} RenderColor;
+
+extern const RenderColor render_default_colors[COLORS];
+
+/* Same colors packed as RGBA pixels, R first in memory as GdkPixbuf wants */
+typedef struct {
+    uint32_t fg, bg, iow, irq, steal;
+    uint32_t temp[100], freq[100];
+    uint32_t peak[100]; /* half-way between frequency and background */
+    uint32_t heat[100]; /* from background to max frequency, for the heatmap */
+} Palette;
+
+void palette_build(Palette* palette, const RenderColor* colors, int transparent);
+
+typedef struct {
+    int peaks;     /* draw the peak of each column above its average */
+    int heatmap;   /* one band per core, or group of cores, instead of bars */
+    int shade;     /* series bars are shaded by: H_FREQ, H_FREQ_MAX or H_POWER */
+    int strip;     /* series drawn in the bottom strip: H_IOWAIT or H_PSI_* */
+} RenderOptions;
+
+typedef struct { int x, y; } RenderPoint;
+
+typedef struct {
+    int n_cores, size;
+    uint32_t* pixels;        /* size*size, owned by the caller */
+    HistoryColumns* columns;
+    unsigned span;           /* ticks covered by the last render() */
+
+    /* Pixel sizes of all columns, newest first, computed in bulk each time:
+     * C_ROWS rows for the bars, or one shade per group of cores in the
+     * heatmap. 'painted' holds what is on the icon, to repaint only what
+     * changed. Both are [rows][size]. */
+    int column_rows, heatmap;
+    int16_t *column_sizes, *painted;
+    int* group_usage;
+
+    RenderPoint termometer[13], tube[6];
+    int termometer_width;    /* columns covered by the termometer */
+    int painted_termo;
+    int stale;               /* repaint everything on the next render() */
+} Renderer;
+
+Renderer* renderer_new(int n_cores);
+/* Starts drawing at 'size' pixels into 'pixels'. Returns -1 if out of memory */
+int renderer_resize(Renderer* r, int size, uint32_t* pixels);
+void renderer_free(Renderer* r);
+
+/* Redraws the icon from history, repainting only what changed. 'temp' is in
+ * Celsius, 0 if unknown, and 'blink' hides it on alternate ticks when too
+ * hot. Returns whether any pixel changed. */
+int render(Renderer* r, const History* h, const Palette* palette,
+           const RenderOptions* options, int temp, int blink);
+
+/* The tooltip text, as snprintf() does, listing the 'n_top' processes in
+ * 'top' as procs_scan() gives them. 'span' is in seconds. */
+int render_tooltip(char* buf, size_t size, const Sample* sample,
+                   const ProcsTop* top, int n_top, unsigned span);
+
+/* As history_check_kernels(), for the column kernels */
+int render_check_kernels(unsigned seed);
+
+#endif
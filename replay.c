@@ -0,0 +1,167 @@
+/* gatotray-replay: runs a trace through the tray's tick, without GTK.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Traces come from `gatotray-cli --record FILE`. Each tick goes as in the
+ * tray's timeout_cb() when sampling on the tick: the sample covers the
+ * readings since the last tick, a stretched tick pushes that many copies,
+ * the icon is redrawn, and power saving picks the next interval. Time is
+ * the trace's own, so ticks run as fast as they can, or --speed times
+ * faster than real time.
+ *
+ * With --output DIR every frame that changed is written as a PNG named
+ * after its second in the trace. The last line printed has a hash of the
+ * final frame, to compare runs against a known good one:
+ *   {"ticks":T,"frames":F,"trace_seconds":S,"wall_seconds":W,"frame_hash":"H"}
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <getopt.h>
+
+#include "cpu_usage.h"
+#include "history.h"
+#include "render.h"
+#include "schedule.h"
+#include "trace.h"
+#include "png.h"
+
+static void
+usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s [-s SPEED] [-o DIR] [-z SIZE] [-H] [-P] TRACE\n"
+                    "  -s, --speed X      X times real time (default: as fast as it goes)\n"
+                    "  -o, --output DIR   write every changed frame to DIR as PNG\n"
+                    "  -z, --size PX      icon size (default 22)\n"
+                    "  -H, --heatmap      draw the per-core heatmap\n"
+                    "  -P, --no-power-saving  tick every second\n", argv0);
+}
+
+static unsigned long long
+frame_hash(const uint32_t* pixels, int n)
+{
+    /* FNV-1a */
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    const uint8_t* p = (const uint8_t*)pixels;
+    for(size_t i=0; i<n*sizeof(*pixels); i++)
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+static long long
+now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000000LL + t.tv_nsec;
+}
+
+int
+main(int argc, char* argv[])
+{
+    static const struct option options[] = {
+        { "speed",  required_argument, NULL, 's' },
+        { "output", required_argument, NULL, 'o' },
+        { "size",   required_argument, NULL, 'z' },
+        { "heatmap", no_argument,      NULL, 'H' },
+        { "no-power-saving", no_argument, NULL, 'P' },
+        { "help",   no_argument,       NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    double speed = 0;
+    const char* output = NULL;
+    int size = 22, heatmap = 0, power_saving = 1, opt;
+    while( (opt = getopt_long(argc, argv, "s:o:z:HPh", options, NULL)) != -1 )
+        switch( opt ) {
+            case 's': speed = atof(optarg); break;
+            case 'o': output = optarg; break;
+            case 'z': size = atoi(optarg); break;
+            case 'H': heatmap = 1; break;
+            case 'P': power_saving = 0; break;
+            default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    if( speed < 0 || size < 1 || size > 1024 || optind != argc-1 ) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    Trace* trace = trace_open(argv[optind]);
+    if( !trace ) {
+        fprintf(stderr, "%s: can't read a trace from %s\n", argv[0], argv[optind]);
+        return 1;
+    }
+    int n_cores = trace->n_cores;
+    History* history = history_new(H_CORES+n_cores);
+    Renderer* renderer = renderer_new(n_cores);
+    int* values = malloc((H_CORES+n_cores)*sizeof(int));
+    uint32_t* pixels = malloc((size_t)size*size*sizeof(*pixels));
+    if( !history || !renderer || !values || !pixels
+     || renderer_resize(renderer, size, pixels) < 0 ) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+    /* As the tray does by default */
+    Palette palette;
+    palette_build(&palette, render_default_colors, 1);
+    RenderOptions render_options = { .peaks = 1, .heatmap = heatmap, .shade = H_FREQ, .strip = H_IOWAIT };
+    Schedule schedule;
+    schedule_init(&schedule, power_saving ? SCHEDULE_MAX_INTERVAL : 1);
+
+    Sample sample = { 0 };
+    long long start = now_ns(), first = trace->cur.ms, clock = first;
+    unsigned timer = 0;
+    long ticks_done = 0, frames = 0;
+    int ret = 0;
+    for(;;)
+    {
+        int ticks = schedule.interval;
+        timer += ticks;
+        clock += ticks*1000LL;
+        int moved = trace_replay(trace, clock, &sample, SCALE);
+        if( moved < 0 ) {
+            fprintf(stderr, "%s: %s is corrupt after %ld records\n", argv[0], argv[optind], trace->records);
+            ret = 1;
+        }
+        if( moved <= 0 )
+            break;
+
+        render_sample(values, &sample, n_cores);
+        for(int i=0; i<ticks; i++)
+            history_push(history, values);
+        if( render(renderer, history, &palette, &render_options, sample.temp, !(timer&1)) ) {
+            frames++;
+            if( output ) {
+                char path[512];
+                snprintf(path, sizeof(path), "%s/frame-%08lld.png", output, (clock-first)/1000);
+                if( png_write(path, pixels, size, size) < 0 ) {
+                    fprintf(stderr, "%s: can't write %s: %s\n", argv[0], path, strerror(errno));
+                    return 1;
+                }
+            }
+        }
+        ticks_done++;
+        schedule_next(&schedule, sample.cpu.usage, sample.temp);
+
+        if( speed > 0 ) {
+            /* To absolute deadlines on the trace's clock, sped up */
+            long long due = start + (clock - first)*1e6/speed;
+            struct timespec t = { due / 1000000000, due % 1000000000 };
+            while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &t, NULL) == EINTR )
+                ;
+        }
+    }
+    printf("{\"ticks\":%ld,\"frames\":%ld,\"trace_seconds\":%lld,\"wall_seconds\":%.3f,"
+           "\"frame_hash\":\"%016llx\"}\n", ticks_done, frames, (clock-first)/1000,
+           (now_ns()-start)/1e9, frame_hash(pixels, size*size));
+    trace_close(trace);
+    renderer_free(renderer);
+    history_free(history);
+    free(values);
+    free(pixels);
+    return ret;
+}
@@ -0,0 +1,180 @@
+/* Background sampling at a high rate, feeding a lock-free ring.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * The ring has one producer, the thread, and one consumer, whoever calls
+ * sampler_thread_drain(). Each side only writes its own index, published
+ * with release stores and read with acquire loads, and the two sit on
+ * separate cache lines. A full ring drops the newest sample, counting it.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sampler_thread.h"
+
+struct SamplerThread {
+    pthread_t thread;
+    int rate, scale;
+    int running;                /* cleared to stop the thread */
+    unsigned long dropped;
+    unsigned size;              /* power of 2 */
+    Sample* ring;
+
+    unsigned head __attribute__((aligned(64))); /* written by the producer */
+    unsigned tail __attribute__((aligned(64))); /* written by the consumer */
+};
+
+static void*
+sampler_loop(void* arg)
+{
+    SamplerThread* t = arg;
+    long long period = 1000000000LL / t->rate;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while( __atomic_load_n(&t->running, __ATOMIC_RELAXED) )
+    {
+        long long ns = next.tv_nsec + period;
+        next.tv_sec += ns / 1000000000;
+        next.tv_nsec = ns % 1000000000;
+        while( clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR )
+            ;
+
+        unsigned head = t->head;
+        if( head - __atomic_load_n(&t->tail, __ATOMIC_ACQUIRE) == t->size ) {
+            __atomic_add_fetch(&t->dropped, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if( sampler_read(&t->ring[head & (t->size-1)], t->scale) < 0 )
+            continue;
+        __atomic_store_n(&t->head, head+1, __ATOMIC_RELEASE);
+
+        /* Fell behind, e.g. after a suspend: don't try to catch up */
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if( now.tv_sec > next.tv_sec + 1 )
+            next = now;
+    }
+    return NULL;
+}
+
+SamplerThread*
+sampler_thread_start(int rate, int scale)
+{
+    SamplerThread* t = calloc(1, sizeof(*t));
+    if( !t )
+        return NULL;
+    t->rate = rate < 1 ? 1 : rate > SAMPLER_MAX_RATE ? SAMPLER_MAX_RATE : rate;
+    t->scale = scale;
+    /* Room for two seconds, in case the main loop is held up */
+    for(t->size = 1; t->size < 2*t->rate; t->size *= 2)
+        ;
+    t->running = 1;
+    if( !(t->ring = malloc(t->size*sizeof(*t->ring)))
+     || pthread_create(&t->thread, NULL, sampler_loop, t) ) {
+        free(t->ring);
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+#define FOLD(field) do { \
+        if( s->field < min->field ) min->field = s->field; \
+        if( s->field > max->field ) max->field = s->field; \
+        sum.field += s->field; \
+    } while(0)
+
+int
+sampler_thread_drain(SamplerThread* t, Sample* min, Sample* max, Sample* mean)
+{
+    unsigned tail = t->tail, head = __atomic_load_n(&t->head, __ATOMIC_ACQUIRE);
+    int n = head - tail;
+    if( !n )
+        return 0;
+
+    const Sample* s = &t->ring[tail & (t->size-1)];
+    *min = *max = *s;
+    struct { CPU_Usage cpu; CPU_Freq freq; long long freq_avg, freq_max, temp, throttled;
+             RAPL_Power power; Mem_Usage mem; Disk_IO disk; Net_IO net;
+             PSI_Stall psi[PSI_RESOURCES]; CPU_Usage core[SAMPLE_MAX_CORES]; } sum = { { 0 } };
+    for( ; tail != head; tail++)
+    {
+        s = &t->ring[tail & (t->size-1)];
+        FOLD(cpu.usage); FOLD(cpu.iowait);
+        FOLD(cpu.irq); FOLD(cpu.steal); FOLD(cpu.guest);
+        FOLD(freq.min); FOLD(freq.avg); FOLD(freq.max);
+        FOLD(freq_avg); FOLD(freq_max); FOLD(temp); FOLD(throttled);
+        FOLD(power.package); FOLD(power.dram); FOLD(power.share);
+        FOLD(mem.used); FOLD(mem.swap); FOLD(mem.available); FOLD(mem.swap_used);
+        FOLD(disk.read); FOLD(disk.written); FOLD(disk.busy); FOLD(net.rx); FOLD(net.tx);
+        for(int r=0; r<PSI_RESOURCES; r++) {
+            FOLD(psi[r].some); FOLD(psi[r].full);
+        }
+        if( s->n_cores < min->n_cores )
+            min->n_cores = s->n_cores;
+        for(int i=0; i<min->n_cores; i++) {
+            FOLD(core[i].usage); FOLD(core[i].iowait);
+        }
+    }
+    /* Descriptions come from the newest sample, copied before its slot
+     * is handed back */
+    *mean = *s;
+    __atomic_store_n(&t->tail, tail, __ATOMIC_RELEASE);
+
+    mean->cpu.usage = sum.cpu.usage / n;
+    mean->cpu.iowait = sum.cpu.iowait / n;
+    mean->cpu.irq = sum.cpu.irq / n;
+    mean->cpu.steal = sum.cpu.steal / n;
+    mean->cpu.guest = sum.cpu.guest / n;
+    mean->freq.min = sum.freq.min / n;
+    mean->freq.avg = sum.freq.avg / n;
+    mean->freq.max = sum.freq.max / n;
+    mean->freq_avg = sum.freq_avg / n;
+    mean->freq_max = sum.freq_max / n;
+    mean->temp = sum.temp / n;
+    mean->throttled = sum.throttled / n;
+    mean->power.package = sum.power.package / n;
+    mean->power.dram = sum.power.dram / n;
+    mean->power.share = sum.power.share / n;
+    mean->mem.used = sum.mem.used / n;
+    mean->mem.swap = sum.mem.swap / n;
+    mean->mem.available = sum.mem.available / n;
+    mean->mem.swap_used = sum.mem.swap_used / n;
+    mean->disk.read = sum.disk.read / n;
+    mean->disk.written = sum.disk.written / n;
+    mean->disk.busy = sum.disk.busy / n;
+    mean->net.rx = sum.net.rx / n;
+    mean->net.tx = sum.net.tx / n;
+    for(int r=0; r<PSI_RESOURCES; r++) {
+        mean->psi[r].some = sum.psi[r].some / n;
+        mean->psi[r].full = sum.psi[r].full / n;
+    }
+    mean->n_cores = max->n_cores = min->n_cores;
+    for(int i=0; i<min->n_cores; i++) {
+        mean->core[i].usage = sum.core[i].usage / n;
+        mean->core[i].iowait = sum.core[i].iowait / n;
+    }
+    return n;
+}
+
+unsigned long
+sampler_thread_dropped(const SamplerThread* t)
+{
+    return __atomic_load_n(&t->dropped, __ATOMIC_RELAXED);
+}
+
+void
+sampler_thread_stop(SamplerThread* t)
+{
+    if( !t )
+        return;
+    __atomic_store_n(&t->running, 0, __ATOMIC_RELAXED);
+    pthread_join(t->thread, NULL);
+    free(t->ring);
+    free(t);
+}
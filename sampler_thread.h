@@ -0,0 +1,30 @@
+/* Background sampling at a high rate, feeding a lock-free ring.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * While a sampler thread runs it owns the collectors: nothing else may call
+ * sampler_read() or the collectors behind it, except for the temperature
+ * sensor selection, which is locked.
+ */
+#ifndef SAMPLER_THREAD_H
+#define SAMPLER_THREAD_H
+
+#include "cpu_usage.h"
+
+#define SAMPLER_MAX_RATE 100 /* Hz; /proc/stat only counts every 10ms */
+
+typedef struct SamplerThread SamplerThread;
+
+/* Starts sampling 'rate' times per second, values scaled to 0~scale.
+ * Returns NULL if out of memory or the thread can't be created. */
+SamplerThread* sampler_thread_start(int rate, int scale);
+/* Folds every sample since the last call into their min, max and mean.
+ * Returns how many there were, leaving the outputs untouched if none. */
+int sampler_thread_drain(SamplerThread* t, Sample* min, Sample* max, Sample* mean);
+/* Samples lost because the ring was full */
+unsigned long sampler_thread_dropped(const SamplerThread* t);
+void sampler_thread_stop(SamplerThread* t);
+
+#endif
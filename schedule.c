@@ -0,0 +1,43 @@
+/* Adaptive tick interval: longer while idle and stable, 1s under load.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * The interval doubles after each quiet tick, up to max_interval, and drops
+ * back to 1s as soon as usage rises or moves, or the termometer would blink.
+ * A stretched tick stands for 'interval' seconds of the same reading, so
+ * history keeps one sample per second.
+ */
+#include "schedule.h"
+#include "render.h"
+
+#define QUIET_USAGE (SCALE/10) /* below this is idle */
+#define QUIET_DELTA (SCALE/50) /* and moving less than this is stable */
+#define QUIET_TEMP 2           /* degrees of drift still considered stable */
+
+void
+schedule_init(Schedule* s, int max_interval)
+{
+    s->interval = 1;
+    s->max_interval = max_interval < 1 ? 1 : max_interval;
+    s->last_usage = s->last_temp = 0;
+}
+
+int
+schedule_next(Schedule* s, int usage, int temp)
+{
+    int delta = usage - s->last_usage, drift = temp - s->last_temp;
+    int quiet = usage < QUIET_USAGE && delta < QUIET_DELTA && -delta < QUIET_DELTA
+             && drift <= QUIET_TEMP && -drift <= QUIET_TEMP && temp < RENDER_HOT_TEMP;
+    s->last_usage = usage;
+    s->last_temp = temp;
+    if( !quiet )
+        s->interval = 1;
+    else if( s->interval < s->max_interval )
+        s->interval = s->interval*2 < s->max_interval ? s->interval*2 : s->max_interval;
+    /* max_interval may have just been lowered */
+    if( s->interval > s->max_interval )
+        s->interval = s->max_interval;
+    return s->interval;
+}
@@ -0,0 +1,23 @@
+/* Adaptive tick interval: longer while idle and stable, 1s under load.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ */
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#define SCHEDULE_MAX_INTERVAL 8 /* seconds */
+
+typedef struct {
+    int interval;     /* seconds between ticks, as last returned */
+    int max_interval; /* 1 disables stretching */
+    int last_usage, last_temp;
+} Schedule;
+
+void schedule_init(Schedule* s, int max_interval);
+/* Seconds until the next tick, after one reading 'usage' in 0~SCALE and
+ * 'temp' in Celsius. Also becomes the new s->interval. */
+int schedule_next(Schedule* s, int usage, int temp);
+
+#endif
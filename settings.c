@@ -15,13 +15,19 @@ static gchar* pref_filename =  "gatotrayrc";
 static GKeyFile* pref_file = NULL;
 
 GdkColor fg_color, bg_color, iow_color;
-GdkColor temp_min_color, temp_max_color, temp_gradient[100];
-GdkColor freq_min_color, freq_max_color, freq_gradient[100];
+GdkColor temp_min_color, temp_max_color;
+GdkColor freq_min_color, freq_max_color;
+GdkColor irq_color, steal_color;
+// Same colors packed as RGBA pixels, ready to be stored into a GdkPixbuf.
+Palette palette;
+// Bumped on every change, so the icon knows it must be fully repainted.
+int pref_changes = 0;
 typedef struct {
     const gchar* description;
     const gchar* preset;
     GdkColor* color;
 } PrefColor;
+// In the order of the COLOR_* palette inputs.
 PrefColor pref_colors[] = {
     { "Foreground", "black", &fg_color },
     { "Background", "white", &bg_color },
@@ -30,25 +36,82 @@ PrefColor pref_colors[] = {
     { "Max frequency", "red", &freq_max_color },
     { "Min temperature", "blue", &temp_min_color },
     { "Max temperature", "red", &temp_max_color },
+    { "IRQ", "orange", &irq_color },
+    { "Steal", "magenta", &steal_color },
 };
 
 // Decides whether the icon has a transparent background.
 gboolean pref_transparent = TRUE;
 
+// Draws the peak usage of each column above its average.
+gboolean pref_peaks = TRUE;
+
+// Shows one band per core (or group of cores) instead of the usage bars.
+gboolean pref_heatmap = FALSE;
+
+// Shades bars by the fastest cpufreq policy instead of the average of all.
+gboolean pref_shade_max = FALSE;
+
+// Bottom strip: 0 for I/O wait, or 1 + the PSI_* resource whose stalls it shows.
+gint pref_strip = 0;
+const gchar* pref_strips[] = { "I/O wait", "CPU pressure", "I/O pressure", "Memory pressure" };
+
+// Lists the busiest processes in the tooltip, scanning /proc on each tick.
+gboolean pref_top_procs = TRUE;
+
+// Shades bars by package power, from RAPL, instead of frequency.
+gboolean pref_shade_power = FALSE;
+
+// Ticks less often while the system is idle and stable.
+gboolean pref_power_saving = TRUE;
+
+// Samples per second taken by a background thread, 0 to sample on each tick.
+gint pref_sampling_rate = 0;
+
+// Publishes samples in shared memory for other local tools, see export.h.
+gboolean pref_export = FALSE;
+
+// Cgroup v2 to watch instead of the whole host, below /sys/fs/cgroup. Only
+// set in the preferences file, e.g. Cgroup=system.slice/nginx.service
+gchar* pref_cgroup = "";
+
+// Agents on other hosts to watch, see agent.h. Only set in the preferences
+// file, e.g. Agents=build1:7634;build2:7634;/run/gatotray/agent.sock
+gchar** pref_agents = NULL;
+gsize pref_n_agents = 0;
+
+// Draws the worst of this host and every agent, instead of this host only.
+gboolean pref_agents_worst = TRUE;
+
+// Keeps the last minutes in full and dumps them to the cache directory on
+// a spike, see flight.h. The thresholds are only set in the preferences file.
+gboolean pref_flight = FALSE;
+gint pref_flight_usage = 90;
+gint pref_flight_seconds = 10;
+gint pref_flight_temp = RENDER_HOT_TEMP;
+
+// Extra icons for memory, disk and network, fed on the same tick.
+gboolean pref_memory_icon = FALSE;
+gboolean pref_disk_icon = FALSE;
+gboolean pref_network_icon = FALSE;
+
+// Temperature sensor: "package", "max" for the hottest, or a sensor name.
+gchar* pref_temp_sensor = "package";
+
 // This is the command that is run when the tray icon is left click. Max length 255.
 // gchar* pref_command = "xterm -bg '#222222' -title 'htop' -geometry '100x32+40+40' htop";
 gchar* pref_command = "xterm -title 'top' -geometry '80x24+40+40' top";
 
 // Called when a user preference is changed to recalculate color values.
 void preferences_changed() {
-    for (int i = 0; i < 100; i++) {
-        freq_gradient[i].red   = (freq_min_color.red   * (99 - i) + freq_max_color.red   * i) / 99;
-        freq_gradient[i].green = (freq_min_color.green * (99 - i) + freq_max_color.green * i) / 99;
-        freq_gradient[i].blue  = (freq_min_color.blue  * (99 - i) + freq_max_color.blue  * i) / 99;
-        temp_gradient[i].red   = (temp_min_color.red   * (99 - i) + temp_max_color.red   * i) / 99;
-        temp_gradient[i].green = (temp_min_color.green * (99 - i) + temp_max_color.green * i) / 99;
-        temp_gradient[i].blue  = (temp_min_color.blue  * (99 - i) + temp_max_color.blue  * i) / 99;
+    RenderColor colors[COLORS];
+    for (int i = 0; i < COLORS; i++) {
+        colors[i].red = pref_colors[i].color->red;
+        colors[i].green = pref_colors[i].color->green;
+        colors[i].blue = pref_colors[i].color->blue;
     }
+    palette_build(&palette, colors, pref_transparent);
+    pref_changes++;
 }
 
 // Called when the transparency option is changed.
@@ -57,6 +120,87 @@ void on_transparency_toggled(GtkToggleButton *togglebutton) {
     preferences_changed();
 }
 
+// Called when the peak envelope option is changed.
+void on_peaks_toggled(GtkToggleButton *togglebutton) {
+    pref_peaks = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when the heatmap option is changed.
+void on_heatmap_toggled(GtkToggleButton *togglebutton) {
+    pref_heatmap = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when the bottom strip is picked.
+void on_strip_changed(GtkComboBox *combo) {
+    pref_strip = gtk_combo_box_get_active(combo);
+    preferences_changed();
+}
+
+// Called when the top processes option is changed.
+void on_top_procs_toggled(GtkToggleButton *togglebutton) {
+    pref_top_procs = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when the worst-of-agents option is changed.
+void on_agents_worst_toggled(GtkToggleButton *togglebutton) {
+    pref_agents_worst = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when the flight recorder option is changed.
+void on_flight_toggled(GtkToggleButton *togglebutton) {
+    pref_flight = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when one of the extra icon options is changed.
+void on_extra_icon_toggled(GtkToggleButton *togglebutton, gboolean *pref) {
+    *pref = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when the power saving option is changed.
+void on_power_saving_toggled(GtkToggleButton *togglebutton) {
+    pref_power_saving = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when the sampling rate is changed.
+void on_sampling_rate_changed(GtkSpinButton *spin) {
+    pref_sampling_rate = gtk_spin_button_get_value_as_int(spin);
+    preferences_changed();
+}
+
+// Called when the shared memory export option is changed.
+void on_export_toggled(GtkToggleButton *togglebutton) {
+    pref_export = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when the frequency shading option is changed.
+void on_shade_max_toggled(GtkToggleButton *togglebutton) {
+    pref_shade_max = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when the power shading option is changed.
+void on_shade_power_toggled(GtkToggleButton *togglebutton) {
+    pref_shade_power = gtk_toggle_button_get_active(togglebutton);
+    preferences_changed();
+}
+
+// Called when a temperature sensor is picked or typed.
+void on_temp_sensor_changed(GtkComboBox *combo) {
+    gchar* sensor = gtk_combo_box_get_active_text(combo);
+    if (sensor) {
+        pref_temp_sensor = sensor;
+        cpu_temperature_select(pref_temp_sensor);
+    }
+}
+
 void on_command_changed(GtkEntry *entry) {
     pref_command = g_strdup(gtk_entry_get_text(entry));
     preferences_changed();
@@ -90,6 +234,133 @@ void pref_init() {
     if (!gerror) {
         pref_transparent = transparency;
     }
+    g_clear_error(&gerror);
+
+    // Load the peak envelope option.
+    gboolean peaks = g_key_file_get_boolean(pref_file, "Options", "Show Peaks", &gerror);
+    if (!gerror) {
+        pref_peaks = peaks;
+    }
+    g_clear_error(&gerror);
+
+    // Load the per-core heatmap option.
+    gboolean heatmap = g_key_file_get_boolean(pref_file, "Options", "Per-core Heatmap", &gerror);
+    if (!gerror) {
+        pref_heatmap = heatmap;
+    }
+    g_clear_error(&gerror);
+
+    // Load the frequency shading option.
+    gboolean shade_max = g_key_file_get_boolean(pref_file, "Options", "Shade by Max Frequency", &gerror);
+    if (!gerror) {
+        pref_shade_max = shade_max;
+    }
+    g_clear_error(&gerror);
+
+    // Load the bottom strip option.
+    gint strip = g_key_file_get_integer(pref_file, "Options", "Bottom Strip", &gerror);
+    if (!gerror) {
+        pref_strip = CLAMP(strip, 0, (gint)G_N_ELEMENTS(pref_strips) - 1);
+    }
+    g_clear_error(&gerror);
+
+    // Load the top processes option.
+    gboolean top_procs = g_key_file_get_boolean(pref_file, "Options", "Top Processes", &gerror);
+    if (!gerror) {
+        pref_top_procs = top_procs;
+    }
+    g_clear_error(&gerror);
+
+    // Load the power shading option.
+    gboolean shade_power = g_key_file_get_boolean(pref_file, "Options", "Shade by Power", &gerror);
+    if (!gerror) {
+        pref_shade_power = shade_power;
+    }
+    g_clear_error(&gerror);
+
+    // Load the power saving option.
+    gboolean power_saving = g_key_file_get_boolean(pref_file, "Options", "Power Saving", &gerror);
+    if (!gerror) {
+        pref_power_saving = power_saving;
+    }
+    g_clear_error(&gerror);
+
+    // Load the sampling rate.
+    gint rate = g_key_file_get_integer(pref_file, "Options", "Sampling Rate", &gerror);
+    if (!gerror) {
+        pref_sampling_rate = CLAMP(rate, 0, SAMPLER_MAX_RATE);
+    }
+    g_clear_error(&gerror);
+
+    // Load the shared memory export option.
+    gboolean export = g_key_file_get_boolean(pref_file, "Options", "Export to Shared Memory", &gerror);
+    if (!gerror) {
+        pref_export = export;
+    }
+    g_clear_error(&gerror);
+
+    // Load the temperature sensor option.
+    gchar* sensor = g_key_file_get_string(pref_file, "Options", "Temperature Sensor", NULL);
+    if (sensor) {
+        pref_temp_sensor = sensor;
+    }
+    cpu_temperature_select(pref_temp_sensor);
+
+    // Load the cgroup option, applied once the sampler starts.
+    gchar* cgroup = g_key_file_get_string(pref_file, "Options", "Cgroup", NULL);
+    if (cgroup) {
+        pref_cgroup = cgroup;
+    }
+
+    // Load the agents to watch, connected to once the icon is up.
+    pref_agents = g_key_file_get_string_list(pref_file, "Options", "Agents", &pref_n_agents, NULL);
+    pref_n_agents = MIN(pref_n_agents, AGENT_MAX_CLIENTS);
+
+    // Load the worst-of-agents option.
+    gboolean agents_worst = g_key_file_get_boolean(pref_file, "Options", "Worst of Agents", &gerror);
+    if (!gerror) {
+        pref_agents_worst = agents_worst;
+    }
+    g_clear_error(&gerror);
+
+    // Load the flight recorder option and its trigger.
+    gboolean flight = g_key_file_get_boolean(pref_file, "Options", "Flight Recorder", &gerror);
+    if (!gerror) {
+        pref_flight = flight;
+    }
+    g_clear_error(&gerror);
+    gint flight_usage = g_key_file_get_integer(pref_file, "Options", "Flight Usage", &gerror);
+    if (!gerror) {
+        pref_flight_usage = CLAMP(flight_usage, 0, 100);
+    }
+    g_clear_error(&gerror);
+    gint flight_seconds = g_key_file_get_integer(pref_file, "Options", "Flight Seconds", &gerror);
+    if (!gerror) {
+        pref_flight_seconds = CLAMP(flight_seconds, 0, 3600);
+    }
+    g_clear_error(&gerror);
+    gint flight_temp = g_key_file_get_integer(pref_file, "Options", "Flight Temperature", &gerror);
+    if (!gerror) {
+        pref_flight_temp = CLAMP(flight_temp, 0, 255);
+    }
+    g_clear_error(&gerror);
+
+    // Load the extra icon options.
+    gboolean memory_icon = g_key_file_get_boolean(pref_file, "Options", "Memory Icon", &gerror);
+    if (!gerror) {
+        pref_memory_icon = memory_icon;
+    }
+    g_clear_error(&gerror);
+    gboolean disk_icon = g_key_file_get_boolean(pref_file, "Options", "Disk Icon", &gerror);
+    if (!gerror) {
+        pref_disk_icon = disk_icon;
+    }
+    g_clear_error(&gerror);
+    gboolean network_icon = g_key_file_get_boolean(pref_file, "Options", "Network Icon", &gerror);
+    if (!gerror) {
+        pref_network_icon = network_icon;
+    }
+    g_clear_error(&gerror);
 
     // Load the command option from gatotrayrc "Options" section.
     gchar* value = g_key_file_get_string(pref_file, "Options", "Launch Command", NULL);
@@ -110,6 +381,28 @@ void pref_save() {
 
     // Store the background transparency preference
     g_key_file_set_boolean(pref_file, "Options", "Transparent Background", pref_transparent);
+    g_key_file_set_boolean(pref_file, "Options", "Show Peaks", pref_peaks);
+    g_key_file_set_boolean(pref_file, "Options", "Per-core Heatmap", pref_heatmap);
+    g_key_file_set_boolean(pref_file, "Options", "Shade by Max Frequency", pref_shade_max);
+    g_key_file_set_boolean(pref_file, "Options", "Shade by Power", pref_shade_power);
+    g_key_file_set_integer(pref_file, "Options", "Bottom Strip", pref_strip);
+    g_key_file_set_boolean(pref_file, "Options", "Top Processes", pref_top_procs);
+    g_key_file_set_boolean(pref_file, "Options", "Power Saving", pref_power_saving);
+    g_key_file_set_integer(pref_file, "Options", "Sampling Rate", pref_sampling_rate);
+    g_key_file_set_boolean(pref_file, "Options", "Export to Shared Memory", pref_export);
+    g_key_file_set_string(pref_file, "Options", "Temperature Sensor", pref_temp_sensor);
+    g_key_file_set_string(pref_file, "Options", "Cgroup", pref_cgroup);
+    if (pref_agents)
+        g_key_file_set_string_list(pref_file, "Options", "Agents",
+                                   (const gchar* const*)pref_agents, pref_n_agents);
+    g_key_file_set_boolean(pref_file, "Options", "Worst of Agents", pref_agents_worst);
+    g_key_file_set_boolean(pref_file, "Options", "Memory Icon", pref_memory_icon);
+    g_key_file_set_boolean(pref_file, "Options", "Disk Icon", pref_disk_icon);
+    g_key_file_set_boolean(pref_file, "Options", "Network Icon", pref_network_icon);
+    g_key_file_set_boolean(pref_file, "Options", "Flight Recorder", pref_flight);
+    g_key_file_set_integer(pref_file, "Options", "Flight Usage", pref_flight_usage);
+    g_key_file_set_integer(pref_file, "Options", "Flight Seconds", pref_flight_seconds);
+    g_key_file_set_integer(pref_file, "Options", "Flight Temperature", pref_flight_temp);
     // Store the command preference.
     g_key_file_set_string(pref_file, "Options", "Launch Command", pref_command);
 
@@ -181,6 +474,111 @@ void show_pref_dialog() {
     g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_transparency_toggled), NULL);
     gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
 
+    // Add the peak envelope checkbox.
+    cbutton = gtk_check_button_new_with_label("Show Peaks");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), pref_peaks);
+    g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_peaks_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+
+    // Add the per-core heatmap checkbox.
+    cbutton = gtk_check_button_new_with_label("Per-core Heatmap");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), pref_heatmap);
+    g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_heatmap_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+
+    // Add the frequency shading checkbox.
+    cbutton = gtk_check_button_new_with_label("Shade by Max Frequency");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), pref_shade_max);
+    g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_shade_max_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+
+    // Add the power shading checkbox.
+    cbutton = gtk_check_button_new_with_label("Shade by Power");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), pref_shade_power);
+    g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_shade_power_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+
+    // Add the top processes checkbox.
+    cbutton = gtk_check_button_new_with_label("Top Processes");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), pref_top_procs);
+    g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_top_procs_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+
+    // Add the worst-of-agents checkbox, where there are agents.
+    if (pref_n_agents) {
+        cbutton = gtk_check_button_new_with_label("Worst of Agents");
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), pref_agents_worst);
+        g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_agents_worst_toggled), NULL);
+        gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+    }
+
+    // Add the extra icon checkboxes.
+    struct { const gchar* label; gboolean* pref; } extra_icons[] = {
+        { "Memory Icon", &pref_memory_icon },
+        { "Disk Icon", &pref_disk_icon },
+        { "Network Icon", &pref_network_icon },
+    };
+    for (int i = 0; i < G_N_ELEMENTS(extra_icons); i++) {
+        cbutton = gtk_check_button_new_with_label(extra_icons[i].label);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), *extra_icons[i].pref);
+        g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_extra_icon_toggled), extra_icons[i].pref);
+        gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+    }
+
+    // Add the flight recorder checkbox.
+    cbutton = gtk_check_button_new_with_label("Flight Recorder");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), pref_flight);
+    g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_flight_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+
+    // Add the power saving checkbox.
+    cbutton = gtk_check_button_new_with_label("Power Saving");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), pref_power_saving);
+    g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_power_saving_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+
+    // Add the shared memory export checkbox.
+    cbutton = gtk_check_button_new_with_label("Export to Shared Memory");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(cbutton), pref_export);
+    g_signal_connect(G_OBJECT(cbutton), "toggled", G_CALLBACK(on_export_toggled), NULL);
+    gtk_box_pack_start(GTK_BOX(vb), cbutton, FALSE, FALSE, 0);
+
+    // Add the sampling rate, where 0 means once per tick.
+    GtkWidget *rb = gtk_hbox_new(FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vb), rb, FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(rb), gtk_label_new("Samples per second"));
+    GtkWidget *spin = gtk_spin_button_new_with_range(0, SAMPLER_MAX_RATE, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin), pref_sampling_rate);
+    g_signal_connect(G_OBJECT(spin), "value-changed", G_CALLBACK(on_sampling_rate_changed), NULL);
+    gtk_box_pack_start(GTK_BOX(rb), spin, FALSE, FALSE, 0);
+
+    // Add the bottom strip picker, for I/O wait or pressure stalls.
+    GtkWidget *bb = gtk_hbox_new(FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vb), bb, FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(bb), gtk_label_new("Bottom Strip"));
+    GtkWidget *strip = gtk_combo_box_new_text();
+    for (int i = 0; i < G_N_ELEMENTS(pref_strips); i++) {
+        gtk_combo_box_append_text(GTK_COMBO_BOX(strip), pref_strips[i]);
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(strip), pref_strip);
+    g_signal_connect(G_OBJECT(strip), "changed", G_CALLBACK(on_strip_changed), NULL);
+    gtk_box_pack_start(GTK_BOX(bb), strip, FALSE, FALSE, 0);
+
+    // Add the temperature sensor picker, which also accepts a typed name.
+    GtkWidget *sb = gtk_hbox_new(FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vb), sb, FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(sb), gtk_label_new("Temperature"));
+    GtkWidget *combo = gtk_combo_box_entry_new_text();
+    gtk_combo_box_append_text(GTK_COMBO_BOX(combo), "package");
+    gtk_combo_box_append_text(GTK_COMBO_BOX(combo), "max");
+    char sensor[48];
+    for (int i = 0; cpu_temperature_sensor(i, sensor, sizeof(sensor)); i++) {
+        gtk_combo_box_append_text(GTK_COMBO_BOX(combo), sensor);
+    }
+    gtk_entry_set_text(GTK_ENTRY(gtk_bin_get_child(GTK_BIN(combo))), pref_temp_sensor);
+    g_signal_connect(G_OBJECT(combo), "changed", G_CALLBACK(on_temp_sensor_changed), NULL);
+    gtk_box_pack_start(GTK_BOX(sb), combo, FALSE, FALSE, 0);
+
     frame = gtk_frame_new("Command run when tray icon is clicked:"); // create command frame.
     gtk_container_add(GTK_CONTAINER(wb), frame); // add command frame to full-width container.
     vb = gtk_hbox_new(FALSE, 0); // create the text box for entering command.
@@ -0,0 +1,89 @@
+/* Self-instrumentation: latency histograms and process footprint.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Recording is a clock read and a few adds into fixed memory, cheap enough
+ * to stay on in every build. Everything else happens only when formatting.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+
+static long long started = 0;
+
+long long
+stats_now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    long long now = t.tv_sec*1000000000LL + t.tv_nsec;
+    if( !started )
+        started = now;
+    return now;
+}
+
+void
+stats_record(StatsTimer* timer, long long ns)
+{
+    if( ns < 1 )
+        ns = 1;
+    int b = 63 - __builtin_clzll(ns);
+    timer->buckets[b < STATS_BUCKETS ? b : STATS_BUCKETS-1]++;
+    timer->count++;
+    timer->total_ns += ns;
+    if( ns > timer->max_ns )
+        timer->max_ns = ns;
+}
+
+/* Upper bound of the bucket holding the given fraction of samples, in µs */
+static double
+percentile_us(const StatsTimer* timer, double fraction)
+{
+    unsigned long long seen = 0, wanted = timer->count*fraction;
+    for(int b=0; b<STATS_BUCKETS; b++)
+        if( (seen += timer->buckets[b]) > wanted )
+            return ((2ull<<b) < timer->max_ns ? 2ull<<b : timer->max_ns)/1000.;
+    return timer->max_ns/1000.;
+}
+
+/* Resident set size in kB, from /proc/self/statm */
+static long
+rss_kb(void)
+{
+    long pages = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if( f ) {
+        if( 1 != fscanf(f, "%*s %ld", &pages) )
+            pages = 0;
+        fclose(f);
+    }
+    return pages * (sysconf(_SC_PAGESIZE)/1024);
+}
+
+int
+stats_format(char* buf, size_t size, const StatsTimer* timers, int n)
+{
+    size_t len = snprintf(buf, size, "%-10s %8s %9s %9s %9s %9s\n",
+                          "stage", "count", "mean_us", "p50_us", "p99_us", "max_us");
+    for(const StatsTimer* t = timers; t < timers+n; t++)
+        len += snprintf(buf+(len<size?len:size), len<size?size-len:0,
+                        "%-10s %8llu %9.1f %9.1f %9.1f %9.1f\n", t->name, t->count,
+                        t->count ? t->total_ns/1000./t->count : 0.,
+                        percentile_us(t, .5), percentile_us(t, .99), t->max_ns/1000.);
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    double cpu = ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+               + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec)/1e6;
+    double wall = (stats_now() - started)/1e9;
+    len += snprintf(buf+(len<size?len:size), len<size?size-len:0,
+                    "CPU time %.2fs in %.0fs (%.3f%%), RSS %ld kB (peak %ld kB)\n",
+                    cpu, wall, wall > 0 ? 100*cpu/wall : 0., rss_kb(), ru.ru_maxrss);
+    return len;
+}
@@ -0,0 +1,30 @@
+/* Self-instrumentation: latency histograms and process footprint.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ */
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+
+/* Bucket b counts latencies of [2^b, 2^(b+1)) ns, so 32 reach past 2s */
+#define STATS_BUCKETS 32
+
+typedef struct {
+    const char* name;
+    unsigned long long count, total_ns, max_ns;
+    unsigned buckets[STATS_BUCKETS];
+} StatsTimer;
+
+/* Monotonic time in ns, to time stages as: t = stats_now(); ...;
+ * stats_record(&timer, stats_now()-t) */
+long long stats_now(void);
+void stats_record(StatsTimer* timer, long long ns);
+
+/* Describes 'n' timers, then the CPU time, CPU share and RSS of the
+ * process since stats_now() was first called. As snprintf() does. */
+int stats_format(char* buf, size_t size, const StatsTimer* timers, int n);
+
+#endif
@@ -0,0 +1,267 @@
+/* Memory, disk and network collectors.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * /proc/meminfo, /proc/diskstats and /proc/net/dev are kept open and read
+ * with pread() into buffers that only ever grow, as /proc/stat is. Disk
+ * and network counters are summed over whole devices, and turned into
+ * rates over the time elapsed between reads.
+ *
+ * Partitions are told apart from their disk by name, as diskstats lists a
+ * disk before its partitions, named as the kernel does: "sda1" after "sda",
+ * "nvme0n1p1" after "nvme0n1". Loop, ram, zram, device-mapper and md
+ * devices are left out, as they are backed by memory or by disks that are
+ * already counted.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cpu_usage.h"
+
+typedef struct {
+    const char* path;
+    int fd;       /* -1 until opened, -2 if not there */
+    char* buf;
+    size_t size;
+    long long last;  /* us of the last read, for rates */
+} ProcFile;
+
+static ProcFile meminfo = { "/proc/meminfo", -1 };
+static ProcFile diskstats = { "/proc/diskstats", -1 };
+static ProcFile netdev = { "/proc/net/dev", -1 };
+
+static ull disk_read_prev, disk_written_prev, *disk_busy_prev = NULL;
+static int disk_allocated = 0;
+static ull net_rx_prev, net_tx_prev;
+
+static long long
+now_us(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec*1000000LL + t.tv_nsec/1000;
+}
+
+/* The whole file into f->buf, NUL-terminated. Returns its length, or -1. */
+static ssize_t
+proc_file_read(ProcFile* f)
+{
+    if( f->fd == -2 )
+        return -1;
+    if( f->fd < 0 && (f->fd = root_open(f->path)) < 0 ) {
+        f->fd = -2;
+        return -1;
+    }
+    for(;;) {
+        if( !f->buf && !(f->buf = malloc(f->size = f->size ? f->size : 4096)) )
+            return -1;
+        ssize_t len = pread(f->fd, f->buf, f->size-1, 0);
+        if( len < 0 )
+            return -1;
+        if( len < f->size-1 ) {
+            f->buf[len] = '\0';
+            return len;
+        }
+        free(f->buf);
+        f->buf = NULL;
+        f->size *= 2;
+    }
+}
+
+static void
+proc_file_close(ProcFile* f)
+{
+    if( f->fd >= 0 )
+        close(f->fd);
+    f->fd = -1;
+    free(f->buf);
+    f->buf = NULL;
+    f->size = 0;
+    f->last = 0;
+}
+
+static const char*
+skip_field(const char* p)
+{
+    while( *p == ' ' ) p++;
+    while( *p && *p != ' ' && *p != '\n' ) p++;
+    return p;
+}
+
+static const char*
+parse_field(const char* p, ull* value)
+{
+    ull v = 0;
+    while( *p == ' ' ) p++;
+    for( ; (unsigned)(*p-'0') < 10; p++)
+        v = v*10 + (*p-'0');
+    *value = v;
+    return p;
+}
+
+/* Value in kB of the "key:" line, or 0 */
+static ull
+meminfo_value(const char* buf, const char* key)
+{
+    const char* line = strstr(buf, key);
+    ull value = 0;
+    if( line )
+        parse_field(line+strlen(key), &value);
+    return value;
+}
+
+int
+mem_read(Mem_Usage* mem, int scale)
+{
+    memset(mem, 0, sizeof(*mem));
+    if( proc_file_read(&meminfo) < 0 )
+        return -1;
+    ull total = meminfo_value(meminfo.buf, "MemTotal:");
+    ull swap_total = meminfo_value(meminfo.buf, "SwapTotal:");
+    /* Kernels before 3.14 have no MemAvailable */
+    mem->available = meminfo_value(meminfo.buf, "MemAvailable:");
+    if( !mem->available )
+        mem->available = meminfo_value(meminfo.buf, "MemFree:")
+                       + meminfo_value(meminfo.buf, "Cached:");
+    ull swap_free = meminfo_value(meminfo.buf, "SwapFree:");
+    mem->swap_used = swap_total > swap_free ? swap_total - swap_free : 0;
+    if( total && mem->available < total )
+        mem->used = (total - mem->available)*scale/total;
+    if( swap_total )
+        mem->swap = mem->swap_used*scale/swap_total;
+    return 0;
+}
+
+/* Devices not counted, or counted through others */
+static int
+disk_ignored(const char* name, size_t len)
+{
+    static const char* prefixes[] = { "loop", "ram", "zram", "dm-", "md" };
+    for(int i=0; i<sizeof(prefixes)/sizeof(*prefixes); i++)
+        if( len >= strlen(prefixes[i]) && !strncmp(name, prefixes[i], strlen(prefixes[i])) )
+            return 1;
+    return 0;
+}
+
+int
+disk_read(Disk_IO* disk, int scale)
+{
+    memset(disk, 0, sizeof(*disk));
+    if( proc_file_read(&diskstats) < 0 )
+        return -1;
+    long long now = now_us(), elapsed = now - diskstats.last;
+    ull sectors_read = 0, sectors_written = 0;
+    const char* disk_name = NULL; /* of the last whole disk */
+    size_t disk_len = 0;
+    int n = 0;
+    for(const char* p = diskstats.buf; *p; p++) {
+        /* major minor name reads merged sectors ms writes merged sectors ms
+         * in_flight io_ms ... */
+        p = skip_field(skip_field(p));
+        while( *p == ' ' ) p++;
+        const char* name = p;
+        p = skip_field(p);
+        size_t len = p-name;
+        int partition = disk_name && len > disk_len && !strncmp(name, disk_name, disk_len);
+        if( partition ) {
+            /* Digits, after a 'p' if the disk name ends in one itself */
+            const char* suffix = name+disk_len;
+            if( (unsigned)(disk_name[disk_len-1]-'0') < 10 && *suffix++ != 'p' )
+                partition = 0;
+            for( ; partition && suffix < name+len; suffix++)
+                partition = (unsigned)(*suffix-'0') < 10;
+        }
+        if( !partition && !disk_ignored(name, len) ) {
+            ull f[10];
+            for(int i=0; i<10; i++)
+                p = parse_field(p, &f[i]);
+            disk_name = name;
+            disk_len = len;
+            sectors_read += f[2];
+            sectors_written += f[6];
+            /* Time doing I/O of each disk, in ms, kept by position */
+            if( n >= disk_allocated ) {
+                ull* grown = realloc(disk_busy_prev, (n+1)*sizeof(*grown));
+                if( !grown )
+                    return -1;
+                disk_busy_prev = grown;
+                disk_busy_prev[disk_allocated++] = f[9];
+            }
+            if( diskstats.last && elapsed > 0 && f[9] > disk_busy_prev[n] ) {
+                long long busy = (f[9] - disk_busy_prev[n])*1000*scale/elapsed;
+                if( busy > disk->busy )
+                    disk->busy = busy > scale ? scale : busy;
+            }
+            disk_busy_prev[n++] = f[9];
+        }
+        while( *p && *p != '\n' ) p++;
+        if( !*p )
+            break;
+    }
+    ull bytes_read = sectors_read*512, bytes_written = sectors_written*512;
+    if( diskstats.last && elapsed > 0 ) {
+        if( bytes_read > disk_read_prev )
+            disk->read = (bytes_read - disk_read_prev)*1000000/elapsed;
+        if( bytes_written > disk_written_prev )
+            disk->written = (bytes_written - disk_written_prev)*1000000/elapsed;
+    }
+    disk_read_prev = bytes_read;
+    disk_written_prev = bytes_written;
+    diskstats.last = now;
+    return 0;
+}
+
+int
+net_read(Net_IO* net)
+{
+    memset(net, 0, sizeof(*net));
+    if( proc_file_read(&netdev) < 0 )
+        return -1;
+    long long now = now_us(), elapsed = now - netdev.last;
+    ull rx = 0, tx = 0;
+    /* Two header lines, then "  name: rx_bytes 7 more tx_bytes ..." */
+    const char* p = strchr(netdev.buf, '\n');
+    p = p ? strchr(p+1, '\n') : NULL;
+    for( ; p && *++p; p = strchr(p, '\n')) {
+        while( *p == ' ' ) p++;
+        const char* colon = strchr(p, ':');
+        if( !colon )
+            break;
+        /* Loopback traffic never leaves the host */
+        int loopback = colon-p == 2 && !strncmp(p, "lo", 2);
+        ull f[9];
+        p = colon+1;
+        for(int i=0; i<9; i++)
+            p = parse_field(p, &f[i]);
+        if( !loopback ) {
+            rx += f[0];
+            tx += f[8];
+        }
+    }
+    if( netdev.last && elapsed > 0 ) {
+        if( rx > net_rx_prev )
+            net->rx = (rx - net_rx_prev)*1000000/elapsed;
+        if( tx > net_tx_prev )
+            net->tx = (tx - net_tx_prev)*1000000/elapsed;
+    }
+    net_rx_prev = rx;
+    net_tx_prev = tx;
+    netdev.last = now;
+    return 0;
+}
+
+void
+system_close(void)
+{
+    proc_file_close(&meminfo);
+    proc_file_close(&diskstats);
+    proc_file_close(&netdev);
+    free(disk_busy_prev);
+    disk_busy_prev = NULL;
+    disk_allocated = 0;
+}
@@ -0,0 +1,204 @@
+/* Compact binary traces of raw collector readings, for replay.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * A trace is the magic "gatotrac", then the version and the number of cores
+ * as varints, then one record per reading. Records hold the difference of
+ * every value from the record before, zigzag-encoded into varints:
+ *   ms, then CPU_FIELDS counters for each of the 1+n_cores /proc/stat lines,
+ *   freq min, avg and max, scaling min and max, temp
+ * Counters move little from one second to the next, so most take one byte
+ * and a second of 8 cores fits in about 100 bytes.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+static void
+put_varint(FILE* f, unsigned long long v)
+{
+    for( ; v >= 0x80; v >>= 7)
+        putc(0x80 | (v & 0x7f), f);
+    putc(v, f);
+}
+
+/* Returns -1 at the end of the file, or on a truncated varint */
+static int
+get_varint(FILE* f, unsigned long long* v)
+{
+    *v = 0;
+    for(int shift=0; shift<64; shift+=7)
+    {
+        int c = getc(f);
+        if( c == EOF )
+            return -1;
+        *v |= (unsigned long long)(c & 0x7f) << shift;
+        if( !(c & 0x80) )
+            return 0;
+    }
+    return -1;
+}
+
+/* Differences as zigzag, so small negative ones stay small */
+static void
+put_delta(FILE* f, unsigned long long now, unsigned long long before)
+{
+    long long d = now - before;
+    put_varint(f, ((unsigned long long)d << 1) ^ (d >> 63));
+}
+
+static int
+get_delta(FILE* f, unsigned long long* value)
+{
+    unsigned long long z;
+    if( get_varint(f, &z) < 0 )
+        return -1;
+    *value += (z >> 1) ^ -(z & 1);
+    return 0;
+}
+
+#define PUT(field, value) do { \
+        put_delta(t->file, (value), (field)); \
+        (field) = (value); \
+    } while(0)
+
+Trace*
+trace_create(const char* path, int n_cores)
+{
+    if( n_cores > SAMPLE_MAX_CORES )
+        n_cores = SAMPLE_MAX_CORES;
+    Trace* t = calloc(1, sizeof(*t));
+    if( !t || !(t->file = fopen(path, "wb")) ) {
+        free(t);
+        return NULL;
+    }
+    t->n_cores = n_cores;
+    fwrite("gatotrac", 8, 1, t->file);
+    put_varint(t->file, TRACE_VERSION);
+    put_varint(t->file, n_cores);
+    return t;
+}
+
+int
+trace_write(Trace* t, long long ms, const Sample* sample)
+{
+    TraceRecord* r = &t->cur;
+    unsigned long long ms_ = ms, ms_before = r->ms;
+    put_delta(t->file, ms_, ms_before);
+    r->ms = ms;
+    for(int line=0; line<=t->n_cores; line++)
+        for(int f=0; f<CPU_FIELDS; f++)
+            PUT(r->stat[line].time[f], line <= proc_stat_cpus ? proc_stat[line].time[f] : 0);
+    PUT(r->freq.min, sample->freq.min);
+    PUT(r->freq.avg, sample->freq.avg);
+    PUT(r->freq.max, sample->freq.max);
+    PUT(r->scaling_min, scaling_min_freq);
+    PUT(r->scaling_max, scaling_max_freq);
+    PUT(r->temp, sample->temp);
+    t->records++;
+    return ferror(t->file) ? -1 : 0;
+}
+
+/* Reads the record after t->ahead into it. Returns 0 at the end, which a
+ * record cut short by a crash or a kill also is. */
+static int
+trace_read(Trace* t)
+{
+    TraceRecord* r = &t->ahead;
+    unsigned long long v[6] = { r->freq.min, r->freq.avg, r->freq.max,
+                                r->scaling_min, r->scaling_max, r->temp };
+    unsigned long long ms = r->ms;
+    int c = getc(t->file);
+    if( c == EOF )
+        return 0;
+    ungetc(c, t->file);
+    if( get_delta(t->file, &ms) < 0 )
+        return feof(t->file) ? 0 : -1;
+    for(int line=0; line<=t->n_cores; line++)
+        for(int f=0; f<CPU_FIELDS; f++)
+            if( get_delta(t->file, &r->stat[line].time[f]) < 0 )
+                return feof(t->file) ? 0 : -1;
+    for(int i=0; i<6; i++)
+        if( get_delta(t->file, &v[i]) < 0 )
+            return feof(t->file) ? 0 : -1;
+    r->ms = ms;
+    r->freq = (CPU_Freq){ v[0], v[1], v[2] };
+    r->scaling_min = v[3];
+    r->scaling_max = v[4];
+    r->temp = v[5];
+    t->records++;
+    return 1;
+}
+
+Trace*
+trace_open(const char* path)
+{
+    Trace* t = calloc(1, sizeof(*t));
+    if( !t || !(t->file = fopen(path, "rb")) ) {
+        free(t);
+        return NULL;
+    }
+    char magic[8];
+    unsigned long long version, n_cores;
+    if( fread(magic, 8, 1, t->file) != 1 || memcmp(magic, "gatotrac", 8)
+     || get_varint(t->file, &version) < 0 || version != TRACE_VERSION
+     || get_varint(t->file, &n_cores) < 0 || n_cores > SAMPLE_MAX_CORES
+     || (t->n_cores = n_cores, trace_read(t) != 1) ) {
+        fclose(t->file);
+        free(t);
+        return NULL;
+    }
+    t->base = t->cur = t->ahead;
+    t->more = trace_read(t);
+    return t;
+}
+
+int
+trace_replay(Trace* t, long long ms, Sample* sample, int scale)
+{
+    int moved = 0;
+    while( t->more > 0 && t->ahead.ms <= ms ) {
+        t->cur = t->ahead;
+        t->more = trace_read(t);
+        moved = 1;
+    }
+    if( t->more < 0 )
+        return -1;
+    if( !moved )
+        return t->more; /* a gap: the last sample stands */
+
+    /* As sampler_read() would have over base~cur */
+    const TraceRecord *r = &t->cur;
+    CPU_Times prev = t->base.stat[0];
+    sample->cpu = cpu_usage_delta(&r->stat[0], &prev, scale);
+    sample->n_cores = t->n_cores;
+    for(int i=0; i<t->n_cores; i++) {
+        prev = t->base.stat[1+i];
+        sample->core[i] = cpu_usage_delta(&r->stat[1+i], &prev, scale);
+    }
+    sample->freq = r->freq;
+    sample->freq_avg = cpu_freq_scaled(r->freq.avg, r->scaling_min, r->scaling_max, scale);
+    sample->freq_max = cpu_freq_scaled(r->freq.max, r->scaling_min, r->scaling_max, scale);
+    sample->temp = r->temp;
+    snprintf(sample->temp_sensor, sizeof(sample->temp_sensor), "trace");
+    sample->psi_available = 0;
+    sample->cgroup = NULL;
+    sample->throttled = 0;
+    t->base = t->cur;
+    return 1;
+}
+
+int
+trace_close(Trace* t)
+{
+    if( !t )
+        return 0;
+    int ret = fclose(t->file);
+    free(t);
+    return ret;
+}
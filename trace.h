@@ -0,0 +1,50 @@
+/* Compact binary traces of raw collector readings, for replay.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ */
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+
+#include "cpu_usage.h"
+
+#define TRACE_VERSION 1
+
+/* One reading, as the collectors got it */
+typedef struct {
+    long long ms;          /* since the trace started */
+    CPU_Times stat[1+SAMPLE_MAX_CORES]; /* /proc/stat "cpu" and "cpuN" lines */
+    CPU_Freq freq;         /* kHz */
+    int scaling_min, scaling_max;
+    int temp;              /* Celsius */
+} TraceRecord;
+
+typedef struct {
+    FILE* file;
+    int n_cores;
+    long records;          /* written or read so far */
+    TraceRecord cur;       /* the last written or replayed, deltas go from it */
+    TraceRecord base;      /* where the last replayed sample started */
+    TraceRecord ahead;     /* read but not replayed yet, if 'more' */
+    int more;
+} Trace;
+
+/* Starts a trace of 'n_cores' at 'path'. Returns NULL on failure. */
+Trace* trace_create(const char* path, int n_cores);
+/* Appends what the collectors read for 'sample', which sampler_read() just
+ * filled, at 'ms' since the trace started. Returns -1 on failure. */
+int trace_write(Trace* t, long long ms, const Sample* sample);
+
+Trace* trace_open(const char* path);
+/* Reads on until the last reading at or before 'ms', and fills 'sample'
+ * with what sampler_read() would have read over the readings skipped.
+ * Returns 1 if it moved on, 0 at the end, -1 if the trace is corrupt. */
+int trace_replay(Trace* t, long long ms, Sample* sample, int scale);
+
+/* Closes the trace, flushing what was written. Returns -1 on failure. */
+int trace_close(Trace* t);
+
+#endif
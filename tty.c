@@ -0,0 +1,264 @@
+/* Rendering of history as coloured text, for terminals.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ *
+ * Columns are laid out as on the icon: newest on the right, I/O wait at
+ * the bottom, usage above it shaded by frequency with interrupts at its
+ * foot, then steal, and the peak above that.
+ * Each column is worked out in sub-cell steps, 8 per row with blocks, from
+ * U+2581 to U+2588, or 4 per row and 2 columns per cell with braille, from
+ * U+2800. Colors are 24-bit SGR sequences.
+ *
+ * The whole frame is composed into cells, and only the cells that differ
+ * from what was sent before are sent again, moving the cursor only where
+ * the next changed cell is not the one right after the last.
+ */
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tty.h"
+
+TtyRenderer*
+tty_new(int n_cores, int braille)
+{
+    TtyRenderer* t = calloc(1, sizeof(*t));
+    if( !t )
+        return NULL;
+    t->braille = braille;
+    t->columns = history_columns_new(H_CORES+n_cores, 1);
+    if( !t->columns ) {
+        free(t);
+        return NULL;
+    }
+    return t;
+}
+
+int
+tty_resize(TtyRenderer* t, int width, int height)
+{
+    if( width < 1 ) width = 1;
+    if( height < 2 ) height = 2;
+    size_t n = (size_t)width*height;
+    HistoryColumns* columns = history_columns_new(t->columns->n_series, width*(t->braille ? 2 : 1));
+    TtyCell* cells = malloc(2*n*sizeof(*cells));
+    char* out = malloc(n*64 + 64);
+    if( !columns || !cells || !out ) {
+        free(columns);
+        free(cells);
+        free(out);
+        return -1;
+    }
+    free(t->columns);
+    free(t->cells);
+    free(t->out);
+    t->columns = columns;
+    t->cells = cells;
+    t->painted = cells + n;
+    t->out = out;
+    t->out_size = n*64 + 64;
+    t->width = width;
+    t->height = height;
+    t->clear = 1;
+    return 0;
+}
+
+void
+tty_free(TtyRenderer* t)
+{
+    if( !t )
+        return;
+    free(t->columns);
+    free(t->cells);
+    free(t->out);
+    free(t);
+}
+
+/* One column, as heights in sub-cell steps from the bottom */
+typedef struct {
+    int iowait, irq, usage, steal, peak; /* tops of each layer */
+    int shade;
+} TtyColumn;
+
+static TtyColumn
+tty_column(const TtyRenderer* t, const RenderOptions* options, int c, int steps)
+{
+    const HistoryColumns* columns = t->columns;
+    int iowait = history_mean(columns, options->strip)[c];
+    int usage = history_mean(columns, H_USAGE)[c];
+    int irq = history_mean(columns, H_IRQ)[c], steal = history_mean(columns, H_STEAL)[c];
+    int peak = options->peaks ? history_max(columns, H_USAGE)[c] : usage;
+    int shade = history_mean(columns, options->shade)[c];
+    TtyColumn col;
+    col.iowait = iowait*steps/SCALE;
+    col.irq = col.iowait + (irq < usage ? irq : usage)*steps/SCALE;
+    col.usage = col.iowait + usage*steps/SCALE;
+    col.steal = col.usage + steal*steps/SCALE;
+    col.peak = col.iowait + (peak > usage+steal ? peak : usage+steal)*steps/SCALE;
+    if( col.irq > steps ) col.irq = steps;
+    if( col.usage > steps ) col.usage = steps;
+    if( col.steal > steps ) col.steal = steps;
+    if( col.peak > steps ) col.peak = steps;
+    col.shade = shade*99/SCALE;
+    if( col.shade < 0 ) col.shade = 0;
+    if( col.shade > 99 ) col.shade = 99;
+    return col;
+}
+
+/* Color of step 'y' from the bottom, TTY_DEFAULT for background */
+static inline uint32_t
+tty_color(const TtyColumn* col, const Palette* palette, int y)
+{
+    if( y < col->iowait ) return palette->iow;
+    if( y < col->irq ) return palette->irq;
+    if( y < col->usage ) return palette->freq[col->shade];
+    if( y < col->steal ) return palette->steal;
+    if( y < col->peak ) return palette->peak[col->shade];
+    return TTY_DEFAULT;
+}
+
+static void
+tty_blocks(TtyRenderer* t, const Palette* palette, const RenderOptions* options)
+{
+    int rows = t->height-1, steps = rows*8;
+    for(int x=0; x<t->width; x++)
+    {
+        TtyColumn col = tty_column(t, options, t->width-1-x, steps);
+        for(int row=0; row<rows; row++)
+        {
+            TtyCell* cell = &t->cells[row*t->width + x];
+            int base = (rows-1-row)*8, k = 1;
+            uint32_t low = tty_color(&col, palette, base);
+            while( k < 8 && tty_color(&col, palette, base+k) == low )
+                k++;
+            /* Layers only change upwards, the background being the last */
+            if( low == TTY_DEFAULT )
+                *cell = (TtyCell){ ' ', TTY_DEFAULT, TTY_DEFAULT };
+            else if( k == 8 )
+                *cell = (TtyCell){ 0x2588, low, TTY_DEFAULT };
+            else
+                *cell = (TtyCell){ 0x2580 + k, low, tty_color(&col, palette, base+k) };
+        }
+    }
+}
+
+static void
+tty_braille(TtyRenderer* t, const Palette* palette, const RenderOptions* options)
+{
+    /* Dot bits by column and row from the top, per the Unicode layout */
+    static const uint8_t dots[2][4] = { { 0x01, 0x02, 0x04, 0x40 }, { 0x08, 0x10, 0x20, 0x80 } };
+    int rows = t->height-1, steps = rows*4;
+    for(int x=0; x<t->width; x++)
+    {
+        int newest = 2*(t->width-1-x);
+        TtyColumn col[2] = { tty_column(t, options, newest+1, steps),
+                             tty_column(t, options, newest, steps) };
+        for(int row=0; row<rows; row++)
+        {
+            /* One color per cell: the one with most dots */
+            uint32_t color[8], best = TTY_DEFAULT;
+            int count[8], colors = 0, most = 0, bits = 0;
+            for(int side=0; side<2; side++)
+                for(int dy=0; dy<4; dy++)
+                {
+                    uint32_t c = tty_color(&col[side], palette, (rows-row)*4-1-dy);
+                    if( c == TTY_DEFAULT )
+                        continue;
+                    bits |= dots[side][dy];
+                    int i = 0;
+                    while( i < colors && color[i] != c )
+                        i++;
+                    if( i == colors ) {
+                        color[colors] = c;
+                        count[colors++] = 0;
+                    }
+                    if( ++count[i] > most ) {
+                        most = count[i];
+                        best = c;
+                    }
+                }
+            t->cells[row*t->width + x] = (TtyCell){ bits ? 0x2800 + bits : ' ', best, TTY_DEFAULT };
+        }
+    }
+}
+
+static void
+tty_status(TtyRenderer* t, const Sample* s)
+{
+    char line[256];
+    unsigned span = t->span;
+    int len = snprintf(line, sizeof(line), "CPU %3d%% %4d MHz %3dC wa %2d%% %u:%02u:%02u",
+                       s->cpu.usage*100/SCALE, s->freq.avg/1000, s->temp,
+                       (s->cgroup ? s->throttled : s->cpu.iowait)*100/SCALE,
+                       span/3600, span/60%60, span%60);
+    TtyCell* cells = t->cells + (t->height-1)*t->width;
+    for(int x=0; x<t->width; x++)
+        cells[x] = (TtyCell){ x < len ? (unsigned char)line[x] : ' ', TTY_DEFAULT, TTY_DEFAULT };
+}
+
+static char*
+tty_sgr(char* p, int code, uint32_t color)
+{
+    if( color == TTY_DEFAULT )
+        return p + sprintf(p, "\033[%dm", code+1);
+    /* Pixels are RGBA with R first in memory */
+    const uint8_t* rgba = (const uint8_t*)&color;
+    return p + sprintf(p, "\033[%d;2;%d;%d;%dm", code, rgba[0], rgba[1], rgba[2]);
+}
+
+static char*
+tty_utf8(char* p, uint32_t ch)
+{
+    if( ch < 0x80 ) {
+        *p++ = ch;
+    } else if( ch < 0x800 ) {
+        *p++ = 0xc0 | ch>>6;
+        *p++ = 0x80 | (ch & 0x3f);
+    } else {
+        *p++ = 0xe0 | ch>>12;
+        *p++ = 0x80 | (ch>>6 & 0x3f);
+        *p++ = 0x80 | (ch & 0x3f);
+    }
+    return p;
+}
+
+const char*
+tty_render(TtyRenderer* t, const History* h, const Palette* palette,
+           const RenderOptions* options, const Sample* sample, size_t* len)
+{
+    t->span = history_columns(h, t->columns);
+    if( t->braille )
+        tty_braille(t, palette, options);
+    else
+        tty_blocks(t, palette, options);
+    tty_status(t, sample);
+
+    char* p = t->out;
+    if( t->clear ) {
+        p += sprintf(p, "\033[0m\033[2J");
+        t->fg = t->bg = TTY_DEFAULT;
+    }
+    int next = -1; /* where the cursor is, as a cell index */
+    for(int i=0; i<t->width*t->height; i++)
+    {
+        TtyCell c = t->cells[i];
+        if( !t->clear && !memcmp(&c, &t->painted[i], sizeof(c)) )
+            continue;
+        t->painted[i] = c;
+        if( i != next )
+            p += sprintf(p, "\033[%d;%dH", i/t->width + 1, i%t->width + 1);
+        if( c.fg != t->fg )
+            p = tty_sgr(p, 38, t->fg = c.fg);
+        if( c.bg != t->bg )
+            p = tty_sgr(p, 48, t->bg = c.bg);
+        p = tty_utf8(p, c.ch);
+        /* The cursor stays put after the last column */
+        next = (i+1) % t->width ? i+1 : -1;
+    }
+    t->clear = 0;
+    *len = p - t->out;
+    return t->out;
+}
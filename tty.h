@@ -0,0 +1,51 @@
+/* Rendering of history as coloured text, for terminals, without GTK.
+ *
+ * (c) 2011 by gatopeich, licensed under a Creative Commons Attribution 3.0
+ * Unported License: http://creativecommons.org/licenses/by/3.0/
+ * Briefly: Use it however suits you better and just give me due credit.
+ */
+#ifndef TTY_H
+#define TTY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cpu_usage.h"
+#include "history.h"
+#include "render.h"
+
+/* Terminal's own foreground or background, not a palette color */
+#define TTY_DEFAULT 0xffffffffu
+
+typedef struct {
+    uint32_t ch;     /* Unicode code point */
+    uint32_t fg, bg; /* palette pixels, or TTY_DEFAULT */
+} TtyCell;
+
+typedef struct {
+    int braille;             /* 2x4 dots per cell, else eighth blocks */
+    int width, height;       /* in cells, the last row being a status line */
+    HistoryColumns* columns; /* one per cell, or two with braille */
+    unsigned span;           /* ticks covered by the last tty_render() */
+
+    /* What the frame should show, and what the terminal shows */
+    TtyCell *cells, *painted;
+    uint32_t fg, bg;         /* current SGR colors, ~0 if unknown */
+    int clear;               /* clear the screen on the next tty_render() */
+
+    char* out;               /* escape sequences of the last frame */
+    size_t out_size;
+} TtyRenderer;
+
+TtyRenderer* tty_new(int n_cores, int braille);
+/* Starts drawing 'width' by 'height' cells. Returns -1 if out of memory. */
+int tty_resize(TtyRenderer* t, int width, int height);
+void tty_free(TtyRenderer* t);
+
+/* Draws the graph from history, and a status line from 'sample'. Returns
+ * the output for the cells that changed since the last call, cursor moves
+ * and colors included, and its length in 'len'. */
+const char* tty_render(TtyRenderer* t, const History* h, const Palette* palette,
+                       const RenderOptions* options, const Sample* sample, size_t* len);
+
+#endif